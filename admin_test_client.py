@@ -10,10 +10,23 @@ from datetime import datetime
 SERVER_URL = "ws://localhost:9002"
 ADMIN_API_KEY = "admin-api-key-12345678901234567890123456789012"
 
+# Responses not yet handed out, per connection; the server may coalesce
+# several responses into one {"batch": [...]} frame when a client falls behind
+pending_responses = {}
+
+async def receive_message(websocket):
+    pending = pending_responses.setdefault(websocket, [])
+    while not pending:
+        frame = json.loads(await websocket.recv())
+        if isinstance(frame, dict) and isinstance(frame.get("batch"), list):
+            pending.extend(frame["batch"])
+        else:
+            pending.append(frame)
+    return pending.pop(0)
+
 async def send_message(websocket, message):
     await websocket.send(json.dumps(message))
-    response = await websocket.recv()
-    return json.loads(response)
+    return await receive_message(websocket)
 
 async def run_admin_tests():
     try:
@@ -82,6 +95,40 @@ async def run_admin_tests():
             rate_limit_response = await send_message(websocket, rate_limit_request)
             print(f"Rate limit configuration response: {rate_limit_response}")
 
+            # Test 6: Alert Rules
+            print("\n6. Testing Alert Rules")
+            add_rules_request = {
+                "admin": {
+                    "action": "manage_rules",
+                    "operation": "add",
+                    "rules": [
+                        {"sensor_id": "temp_sensor_001", "kind": "threshold", "above": 30.0},
+                        {"type": "temperature", "kind": "rate_of_change", "max_rate": 5.0},
+                        {"type": "humidity", "kind": "n_of_m", "above": 80.0, "n": 3, "m": 5}
+                    ]
+                }
+            }
+            add_rules_response = await send_message(websocket, add_rules_request)
+            print(f"Add rules response: {add_rules_response}")
+
+            subscribe_response = await send_message(websocket, {
+                "admin": {"action": "subscribe_alerts"}
+            })
+            print(f"Alert subscription response: {subscribe_response}")
+
+            alert_response = await send_message(websocket, {
+                "sensor_data": {
+                    "sensor_id": "temp_sensor_001",
+                    "type": "temperature",
+                    "value": 35.0,
+                    "timestamp": int(time.time()),
+                    "unit": "celsius"
+                }
+            })
+            print(f"Sensor data response: {alert_response}")
+            alert = await receive_message(websocket)
+            print(f"Alert: {alert}")
+
     except websockets.exceptions.ConnectionRefusedError:
         print("Error: Could not connect to the server. Make sure it's running.")
     except Exception as e:
@@ -0,0 +1,14 @@
+-- Sensor reading history served by the "history" request
+CREATE TABLE IF NOT EXISTS sensor_readings (
+    id          BIGSERIAL PRIMARY KEY,
+    sensor_id   TEXT NOT NULL,
+    type        TEXT NOT NULL,
+    value       DOUBLE PRECISION NOT NULL,
+    unit        TEXT NOT NULL,
+    "timestamp" TIMESTAMPTZ NOT NULL,
+    metadata    JSONB
+);
+
+-- Matches the (timestamp, id) keyset used to page through results
+CREATE INDEX IF NOT EXISTS sensor_readings_history_idx
+    ON sensor_readings (sensor_id, "timestamp", id);
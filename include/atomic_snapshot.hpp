@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+// Read-mostly immutable value that writers replace wholesale. Readers go
+// through current(), which keeps a per-thread reference and only touches the
+// shared pointer when a writer has published a new version.
+template <typename T>
+class AtomicSnapshot {
+public:
+    explicit AtomicSnapshot(std::shared_ptr<const T> initial) {
+        store(std::move(initial));
+    }
+
+    void store(std::shared_ptr<const T> next) {
+        uint64_t next_version = allocate_version();
+        std::atomic_store(&value, std::shared_ptr<const Versioned>(
+            std::make_shared<Versioned>(Versioned{next_version, std::move(next)})));
+        version.store(next_version, std::memory_order_release);
+    }
+
+    std::shared_ptr<const T> load() const {
+        return std::atomic_load(&value)->data;
+    }
+
+    // The reference stays valid until this thread's next call to current()
+    // on any AtomicSnapshot<T>
+    const T& current() const {
+        struct Cache {
+            uint64_t version = 0;
+            std::shared_ptr<const Versioned> snapshot;
+        };
+        thread_local Cache cache;
+
+        if (cache.version != version.load(std::memory_order_acquire) || !cache.snapshot) {
+            cache.snapshot = std::atomic_load(&value);
+            cache.version = cache.snapshot->version;
+        }
+        return *cache.snapshot->data;
+    }
+
+private:
+    struct Versioned {
+        uint64_t version;
+        std::shared_ptr<const T> data;
+    };
+
+    std::shared_ptr<const Versioned> value;
+    std::atomic<uint64_t> version{0};
+
+    // Versions are unique process-wide so a thread's cached snapshot can never
+    // be mistaken for one belonging to another instance
+    static uint64_t allocate_version() {
+        static std::atomic<uint64_t> next_version{1};
+        return next_version.fetch_add(1, std::memory_order_relaxed);
+    }
+}; 
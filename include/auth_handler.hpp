@@ -1,21 +1,69 @@
 #pragma once
 
 #include <string>
-#include <unordered_set>
+#include <array>
+#include <set>
+#include <vector>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <functional>
+#include "atomic_snapshot.hpp"
 
+// API keys are held only as SHA-256 digests. Validators probe a read-only
+// open-addressed table that writers rebuild and swap in, so validation never
+// waits on add, remove or reload. Sessions and permissions refer to a key by
+// its key id (the hex digest), never by the key itself.
 class AuthHandler {
 public:
+    // Receives the key ids dropped by a remove or reload
+    using RevocationListener = std::function<void(const std::shared_ptr<const std::set<std::string>>&)>;
+
     AuthHandler();
     
+    static std::string key_id(const std::string& api_key);
+    
     bool add_api_key(const std::string& api_key);
     bool remove_api_key(const std::string& api_key);
     bool validate_api_key(const std::string& api_key) const;
+
+    // Replace the whole key set with the keys listed in a file, one per line
+    size_t reload_from_file(const std::string& path);
+    size_t reload_from_file();
+    size_t key_count() const;
+
+    size_t add_revocation_listener(RevocationListener listener);
+    void remove_revocation_listener(size_t listener_id);
     
 private:
-    mutable std::mutex mutex;
-    std::unordered_set<std::string> valid_api_keys;
+    using Digest = std::array<unsigned char, 32>;
+
+    struct KeyTable {
+        struct Slot {
+            bool used = false;
+            Digest digest{};
+        };
+
+        std::vector<Slot> slots;
+        size_t mask = 0;
+        size_t count = 0;
+    };
+
+    std::mutex write_mutex;
+    std::set<Digest> digests;
+    AtomicSnapshot<KeyTable> table;
+    std::string key_file;
+
+    std::mutex listeners_mutex;
+    std::map<size_t, RevocationListener> revocation_listeners;
+    size_t next_listener_id = 1;
     
     static constexpr size_t MIN_API_KEY_LENGTH = 32;
     static bool is_valid_api_key_format(const std::string& api_key);
-}; 
\ No newline at end of file
+    static Digest digest_of(const std::string& api_key);
+    static std::string to_hex(const Digest& digest);
+    static size_t slot_of(const Digest& digest);
+    size_t replace_keys(std::set<Digest> keys);
+    void publish();
+    void notify_revoked(std::set<std::string> key_ids);
+}; 
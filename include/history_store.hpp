@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <cstdint>
+
+// Runs historical sensor queries against PostgreSQL on a small pool of worker
+// threads, each owning one connection with its prepared statement. Results are
+// paged with keyset pagination and handed out chunk by chunk, so the full
+// result set is never materialized. A worker fetches one page per job and then
+// requeues it, so queries share the pool and a paused query holds no thread.
+class HistoryStore {
+public:
+    struct Query {
+        std::string sensor_id;
+        int64_t from = 0;
+        int64_t to = 0;
+        size_t max_rows = 100000;
+        size_t max_bytes = 16 * 1024 * 1024;
+        size_t chunk_rows = 500;
+    };
+
+    struct Chunk {
+        std::string rows;   // JSON array of sensor readings
+        size_t row_count;
+        bool last;
+        bool truncated;
+    };
+
+    // What the worker does with a query after handing out a chunk
+    enum class Flow {
+        CONTINUE,   // fetch the next page
+        PAUSE,      // park the query until resume() is called
+        STOP        // abandon the query
+    };
+
+    struct Job;
+    using JobHandle = std::shared_ptr<Job>;
+
+    // Called on a worker thread
+    using ChunkSink = std::function<Flow(const Chunk&)>;
+    using ErrorSink = std::function<void(const std::string&)>;
+
+    HistoryStore(std::string conninfo, size_t pool_size = 4, size_t max_pending = 64);
+    ~HistoryStore();
+
+    // Returns null if too many queries are already waiting
+    JobHandle submit(Query query, ChunkSink on_chunk, ErrorSink on_error);
+
+    // Requeues a query whose sink returned PAUSE
+    void resume(const JobHandle& job);
+
+    // Builds a libpq connection string from the POSTGRES_* variables
+    static std::string conninfo_from_env();
+
+private:
+    std::string conninfo;
+    size_t max_pending;
+    std::deque<JobHandle> jobs;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_ready;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void worker_loop();
+}; 
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <cstddef>
+#include <cstdint>
+
+// Limits applied to each connection's outbound data (websocket++ buffer plus
+// responses held back for coalescing)
+struct OutboundLimits {
+    enum class Policy {
+        PAUSE_READING,
+        DROP,
+        DISCONNECT
+    };
+
+    size_t max_bytes = 1024 * 1024;
+    size_t max_messages = 256;
+    size_t coalesce_threshold_bytes = 16 * 1024;
+    unsigned int flush_interval_ms = 5;
+    Policy policy = Policy::PAUSE_READING;
+
+    // Reads OUTBOUND_MAX_BYTES, OUTBOUND_MAX_MESSAGES and OUTBOUND_POLICY
+    static OutboundLimits from_env();
+};
+
+// Responses held back while a client is behind, flushed as batched frames
+class OutboundQueue {
+public:
+    void push(std::string payload, uint8_t opcode);
+
+    // Coalesces the leading run of responses that share an opcode into one
+    // frame, sent with that opcode
+    std::string take_batch(uint8_t& opcode);
+
+    bool empty() const { return pending.empty(); }
+    size_t pending_messages() const { return pending.size(); }
+    size_t pending_bytes() const { return bytes; }
+
+private:
+    struct Entry {
+        std::string payload;
+        uint8_t opcode;
+    };
+
+    std::deque<Entry> pending;
+    size_t bytes = 0;
+}; 
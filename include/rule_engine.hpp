@@ -0,0 +1,162 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include "sensor_data.hpp"
+#include "atomic_snapshot.hpp"
+
+// Alert rule as registered by an admin. Exactly one of sensor_id / type is set.
+struct AlertRule {
+    enum class Kind : uint8_t {
+        THRESHOLD,
+        RATE_OF_CHANGE,
+        N_OF_M
+    };
+
+    uint32_t id = 0;
+    std::string sensor_id;
+    std::string type;
+    Kind kind = Kind::THRESHOLD;
+    bool above = true;      // threshold / n_of_m direction
+    double limit = 0.0;     // threshold, or max absolute change per second
+    uint8_t n = 1;
+    uint8_t m = 1;
+};
+
+struct RuleMatch {
+    uint32_t rule_id;
+    AlertRule::Kind kind;
+    std::string sensor_id;
+    std::string type;
+    double value;
+    std::chrono::system_clock::time_point timestamp;
+};
+
+// JSON serialization
+void to_json(nlohmann::json& j, const AlertRule& rule);
+void from_json(const nlohmann::json& j, AlertRule& rule);
+void to_json(nlohmann::json& j, const RuleMatch& match);
+
+// Evaluates alert rules inline on ingest. Rules are compiled into a flat,
+// read-only snapshot indexed by sensor id and type; evaluation only loads the
+// current snapshot and never takes the rules mutex. Rate and window state is
+// kept per (rule, sensor), so a type rule tracks each sensor separately; it is
+// guarded by a lock striped by sensor id and only touched by stateful rules.
+class RuleEngine {
+public:
+    // Receives matches already serialized as {"alerts": [...]}
+    using Listener = std::function<void(const std::shared_ptr<const std::string>&)>;
+
+    RuleEngine();
+
+    uint32_t add_rule(AlertRule rule);
+    std::vector<uint32_t> add_rules(std::vector<AlertRule> rules);
+    bool remove_rule(uint32_t rule_id);
+    std::vector<AlertRule> list_rules() const;
+    size_t rule_count() const;
+
+    // Appends every rule matched by the reading to matches
+    void evaluate(const SensorReading& reading, std::vector<RuleMatch>& matches) const;
+
+    // Match fan-out to interested server shards. publish() reads a
+    // copy-on-write listener list and takes no lock; remove_listener() waits
+    // for publishes still using the removed listener.
+    size_t add_listener(Listener listener);
+    void remove_listener(size_t listener_id);
+    void publish(const std::vector<RuleMatch>& matches);
+
+private:
+    // Hot fields only; 16 bytes per rule
+    struct CompiledRule {
+        double limit;
+        uint32_t id;
+        AlertRule::Kind kind;
+        bool above;
+        uint8_t n;
+        uint8_t m;
+    };
+
+    // Evaluation state of one rule for one sensor
+    struct RuleState {
+        uint64_t window = 0;
+        double last_value = 0.0;
+        int64_t last_time = UNSET_TIME;
+    };
+
+    struct alignas(64) StateStripe {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::unordered_map<uint32_t, RuleState>> sensors;
+    };
+
+    // Locks the reading's stripe on first use and holds it for the rest of
+    // the evaluation
+    class StateCursor {
+    public:
+        StateCursor(const RuleEngine& engine, const std::string& sensor_id);
+        RuleState& state_of(uint32_t rule_id);
+
+    private:
+        const RuleEngine& engine;
+        const std::string& sensor_id;
+        std::unique_lock<std::mutex> lock;
+        std::unordered_map<uint32_t, RuleState>* states = nullptr;
+    };
+
+    struct Range {
+        uint32_t begin;
+        uint32_t count;
+    };
+
+    // Open-addressed key -> range table; keys are only compared on a hash hit
+    class RangeIndex {
+    public:
+        void build(const std::vector<std::pair<std::string, Range>>& entries);
+        const Range* find(const std::string& key) const;
+
+    private:
+        struct Slot {
+            uint64_t hash;
+            Range range;
+            uint32_t key_index;
+        };
+
+        std::vector<Slot> slots;
+        std::vector<std::string> keys;
+        uint64_t mask = 0;
+    };
+
+    struct Snapshot {
+        std::vector<CompiledRule> rules;
+        RangeIndex by_sensor;
+        RangeIndex by_type;
+    };
+
+    static constexpr int64_t UNSET_TIME = INT64_MIN;
+    static constexpr uint8_t MAX_WINDOW = 64;
+    static constexpr size_t STATE_STRIPES = 64;
+
+    mutable std::mutex rules_mutex;
+    std::map<uint32_t, AlertRule> rules;
+    uint32_t next_rule_id = 1;
+    AtomicSnapshot<Snapshot> snapshot;
+    mutable StateStripe state_stripes[STATE_STRIPES];
+
+    using ListenerList = std::vector<std::pair<size_t, Listener>>;
+
+    std::mutex listeners_mutex;     // serializes listener list writers only
+    AtomicSnapshot<ListenerList> listeners;
+    size_t next_listener_id = 1;
+
+    static void validate_rule(const AlertRule& rule);
+    void recompile();
+    void evaluate_range(const Snapshot& snap, Range range, const SensorReading& reading, int64_t seconds,
+                        StateCursor& states, std::vector<RuleMatch>& matches) const;
+}; 
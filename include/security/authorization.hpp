@@ -5,6 +5,7 @@
 #include <vector>
 #include <map>
 #include <mutex>
+#include <shared_mutex>
 
 class Authorization {
 public:
@@ -20,10 +21,13 @@ public:
         std::vector<std::string> allowed_sensor_ids;
     };
 
+    // client_id is the session's key id (AuthHandler::key_id), not the API key
     bool add_client_permissions(const std::string& client_id, const ClientPermissions& permissions);
+    bool remove_client_permissions(const std::string& client_id);
     bool can_access_sensor(const std::string& client_id, const std::string& sensor_id, Permission required_permission);
 
 private:
     std::map<std::string, ClientPermissions> client_permissions;
-    std::mutex permissions_mutex;
+    // Permission checks run on every shard's hot path; only admin edits take the exclusive lock
+    std::shared_mutex permissions_mutex;
 }; 
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <map>
+#include <array>
 #include <queue>
 #include <mutex>
 #include <chrono>
@@ -16,10 +17,18 @@ private:
         std::queue<std::chrono::system_clock::time_point> attempts;
     };
 
-    std::map<std::string, ConnectionHistory> connection_attempts;
-    std::mutex connection_mutex;
+    // Histories are striped by address so accepts on different shards rarely contend
+    static constexpr size_t STRIPE_COUNT = 64;
+
+    struct Stripe {
+        std::map<std::string, ConnectionHistory> connection_attempts;
+        std::mutex connection_mutex;
+    };
+
+    std::array<Stripe, STRIPE_COUNT> stripes;
     unsigned int max_connections;
     unsigned int window_seconds;
 
+    Stripe& stripe_for(const std::string& ip_address);
     void cleanup_old_attempts(ConnectionHistory& history);
-}; 
\ No newline at end of file
+}; 
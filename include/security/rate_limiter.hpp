@@ -2,6 +2,7 @@
 
 #include <string>
 #include <map>
+#include <array>
 #include <mutex>
 #include <chrono>
 
@@ -16,10 +17,18 @@ private:
         std::chrono::system_clock::time_point window_start;
     };
 
-    std::map<std::string, ClientQuota> client_quotas;
-    std::mutex quota_mutex;
+    // Quotas are striped by client id so concurrent shards rarely contend
+    static constexpr size_t STRIPE_COUNT = 64;
+
+    struct Stripe {
+        std::map<std::string, ClientQuota> client_quotas;
+        std::mutex quota_mutex;
+    };
+
+    std::array<Stripe, STRIPE_COUNT> stripes;
     unsigned int max_requests;
     unsigned int window_seconds;
 
-    void cleanup_old_entries();
-}; 
\ No newline at end of file
+    Stripe& stripe_for(const std::string& client_id);
+    void cleanup_old_entries(Stripe& stripe);
+}; 
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "auth_handler.hpp"
+#include "security/rate_limiter.hpp"
+#include "security/authorization.hpp"
+#include "security/dos_protection.hpp"
+#include "rule_engine.hpp"
+#include "history_store.hpp"
+#include "traffic_capture.hpp"
+
+// Security state and counters shared by every server shard. Each member does
+// its own fine-grained locking, so shards never serialize on a common lock.
+struct ServerState {
+    ServerState();
+
+    AuthHandler auth_handler;
+    RateLimiter rate_limiter;
+    Authorization authorization;
+    DosProtection dos_protection;
+    RuleEngine rule_engine;
+    std::unique_ptr<HistoryStore> history_store;
+    std::unique_ptr<TrafficCapture> capture;    // null unless capturing
+
+    std::atomic<size_t> active_connections{0};
+    std::atomic<uint64_t> total_connections{0};
+
+    // Outbound backpressure totals across all shards
+    std::atomic<size_t> outbound_queued_messages{0};
+    std::atomic<size_t> outbound_queued_bytes{0};
+    std::atomic<size_t> outbound_paused_connections{0};
+    std::atomic<uint64_t> outbound_dropped{0};
+    std::atomic<uint64_t> outbound_disconnects{0};
+}; 
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "websocket_server.hpp"
+
+// Runs several independent WebSocketServer event loops, each with its own
+// SO_REUSEPORT listener, so the kernel spreads accepts across cores.
+class ShardedServer {
+public:
+    explicit ShardedServer(size_t shard_count);
+    void run(uint16_t port);
+
+    // Safe to call from any thread; each shard stops on its own event loop
+    void stop();
+
+private:
+    std::shared_ptr<ServerState> state;
+    std::vector<std::unique_ptr<WebSocketServer>> shards;
+}; 
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+
+// Records connection opens, inbound frames and closes to a compact binary
+// file for later replay. Recording only appends to one of a few striped,
+// bounded in-memory buffers; a background thread writes them out. Records that
+// do not fit are dropped and counted rather than stalling the I/O threads.
+//
+// Captures hold inbound frames verbatim, including API keys, so the file is
+// created readable by its owner only.
+//
+// File layout: 8 byte magic "IOTCAP01", u64 capture start (unix ns), then a
+// RecordHeader followed by payload_size payload bytes per event. All integers
+// are in host (little-endian) byte order. The writer merges the stripes, so
+// offsets never decrease through the file.
+class TrafficCapture {
+public:
+    enum class Event : uint8_t {
+        OPEN = 1,
+        MESSAGE = 2,
+        CLOSE = 3
+    };
+
+    struct RecordHeader {
+        uint64_t offset_ns;         // since capture start
+        uint64_t connection_id;
+        uint32_t payload_size;
+        uint8_t event;
+        uint8_t opcode;
+        uint16_t reserved;
+    };
+
+    static constexpr char MAGIC[8] = {'I', 'O', 'T', 'C', 'A', 'P', '0', '1'};
+    static constexpr uint32_t MAX_PAYLOAD_SIZE = 16 * 1024 * 1024;
+
+    explicit TrafficCapture(const std::string& path);
+    ~TrafficCapture();
+
+    uint64_t next_connection_id();
+    void record(Event event, uint64_t connection_id, uint8_t opcode, const std::string& payload);
+    uint64_t dropped_records() const;
+
+    // Returns a capture writing to TRAFFIC_CAPTURE_FILE, or nullptr if unset
+    static std::unique_ptr<TrafficCapture> from_env();
+
+private:
+    // Each recording thread sticks to one stripe, so I/O threads only contend
+    // with the writer thread
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+        std::string buffer;
+    };
+
+    static constexpr size_t STRIPE_COUNT = 16;
+    static constexpr size_t FLUSH_THRESHOLD = 1024 * 1024;
+    static constexpr size_t MAX_STRIPE_BYTES = MAX_PAYLOAD_SIZE + sizeof(RecordHeader);
+
+    std::FILE* file;
+    std::chrono::steady_clock::time_point start;
+    std::atomic<uint64_t> connection_ids{1};
+    std::atomic<size_t> next_stripe{0};
+    std::atomic<uint64_t> dropped{0};
+    Stripe stripes[STRIPE_COUNT];
+
+    std::mutex writer_mutex;
+    std::condition_variable flush_ready;
+    std::atomic<bool> flush_requested{false};
+    bool stopping = false;
+    std::thread writer;
+
+    static std::FILE* open_private(const std::string& path);
+    Stripe& stripe_for_thread();
+    void writer_loop();
+    void write_merged(std::string& held, uint64_t cutoff_ns);
+};
+
+// Sequential reader for capture files
+class CaptureReader {
+public:
+    struct Record {
+        TrafficCapture::Event event;
+        uint64_t offset_ns;
+        uint64_t connection_id;
+        uint8_t opcode;
+        std::string payload;
+    };
+
+    explicit CaptureReader(const std::string& path);
+    ~CaptureReader();
+
+    // Returns false at the end of the file; throws if the file is corrupt
+    bool next(Record& record);
+
+private:
+    std::FILE* file;
+    std::string path;
+    uint64_t last_offset_ns = 0;
+}; 
@@ -3,11 +3,15 @@
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 #include <nlohmann/json.hpp>
-#include "auth_handler.hpp"
+#include <memory>
+#include <set>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <chrono>
 #include "sensor_data.hpp"
-#include "security/rate_limiter.hpp"
-#include "security/authorization.hpp"
-#include "security/dos_protection.hpp"
+#include "server_state.hpp"
+#include "outbound_queue.hpp"
 
 using json = nlohmann::json;
 using websocketpp::connection_hdl;
@@ -17,17 +21,80 @@ public:
     using Server = websocketpp::server<websocketpp::config::asio>;
     using MessagePtr = Server::message_ptr;
 
-    WebSocketServer();
+    // Shards pass a common state; a standalone server creates its own
+    explicit WebSocketServer(std::shared_ptr<ServerState> state = nullptr);
+    ~WebSocketServer();
     void run(uint16_t port);
+
+    // Safe to call from any thread
     void stop();
 
+    // Bind with SO_REUSEPORT so several shards can listen on the same port
+    void set_reuse_port(bool enable);
+
 private:
     Server server;
-    AuthHandler auth_handler;
-    RateLimiter rate_limiter;
-    Authorization authorization;
-    DosProtection dos_protection;
+    std::shared_ptr<ServerState> state;
+    AuthHandler& auth_handler;
+    RateLimiter& rate_limiter;
+    Authorization& authorization;
+    DosProtection& dos_protection;
+    bool reuse_port = false;
+    // Authenticated sessions, by key id (AuthHandler::key_id) rather than API key
     std::map<connection_hdl, std::string, std::owner_less<connection_hdl>> connections;
+
+    // Outbound backpressure
+    struct OutboundState {
+        OutboundQueue queue;
+        bool reading_paused = false;
+        bool flush_scheduled = false;
+    };
+
+    OutboundLimits outbound_limits;
+    std::map<connection_hdl, OutboundState, std::owner_less<connection_hdl>> outbound;
+
+    // Alert rules
+    std::vector<RuleMatch> rule_matches;
+    std::set<connection_hdl, std::owner_less<connection_hdl>> alert_subscribers;
+    std::atomic<size_t> alert_subscriber_count{0};
+    size_t alert_listener_id = 0;
+    size_t revocation_listener_id = 0;
+
+    // Streaming history queries
+    struct HistoryFrame {
+        std::string payload;
+        bool last;
+    };
+
+    struct HistoryStream {
+        connection_hdl hdl;
+        std::string request_id;     // JSON-encoded, echoed in every frame
+        HistoryStore::JobHandle job;
+        size_t sequence = 0;        // advanced by whichever worker runs the job
+
+        // Shared with history workers. Once cancelled is set the workers no
+        // longer touch this server, so the shard may be destroyed.
+        std::mutex mutex;
+        bool cancelled = false;
+        bool parked = false;
+        size_t in_flight = 0;
+
+        // Event loop only; frames are sent strictly in order from the front
+        std::deque<HistoryFrame> frames;
+        bool drain_scheduled = false;
+        std::chrono::steady_clock::time_point last_progress;
+    };
+
+    static constexpr size_t MAX_HISTORY_STREAMS = 2;
+    static constexpr size_t MAX_HISTORY_IN_FLIGHT = 2;
+    static constexpr size_t MAX_HISTORY_ROWS = 100000;
+    static constexpr size_t MAX_HISTORY_BYTES = 16 * 1024 * 1024;
+    static constexpr std::chrono::seconds HISTORY_STALL_TIMEOUT{30};
+
+    std::map<connection_hdl, std::vector<std::shared_ptr<HistoryStream>>, std::owner_less<connection_hdl>> history_streams;
+
+    // Traffic capture ids, only populated while capturing
+    std::map<connection_hdl, uint64_t, std::owner_less<connection_hdl>> capture_ids;
     
     // Message handlers
     void on_message(connection_hdl hdl, MessagePtr msg);
@@ -36,9 +103,19 @@ private:
     
     // Authentication
     bool validate_api_key(const std::string& api_key);
+    void close_revoked_sessions(const std::set<std::string>& revoked);
     
     // Data handlers
     void handle_sensor_data(connection_hdl hdl, const json& data);
+    void handle_history_request(connection_hdl hdl, const json& data);
+    HistoryStore::Flow queue_history_chunk(const std::shared_ptr<HistoryStream>& stream, const HistoryStore::Chunk& chunk);
+    void post_history_error(const std::shared_ptr<HistoryStream>& stream, const std::string& message);
+    void queue_history_frame(const std::shared_ptr<HistoryStream>& stream, HistoryFrame frame);
+    void pump_history_stream(const std::shared_ptr<HistoryStream>& stream);
+    void abort_history_stream(const std::shared_ptr<HistoryStream>& stream, const std::string& message);
+    std::string history_error_frame(const HistoryStream& stream, const std::string& message);
+    void finish_history_stream(const std::shared_ptr<HistoryStream>& stream);
+    void cancel_history_streams(connection_hdl hdl);
     std::string get_client_ip(connection_hdl hdl);
 
     // Admin handlers
@@ -47,9 +124,31 @@ private:
     void handle_user_management(connection_hdl hdl, const json& data);
     void handle_permission_management(connection_hdl hdl, const json& data);
     void handle_rate_limit_config(connection_hdl hdl, const json& data);
+    void handle_rule_management(connection_hdl hdl, const json& data);
+    void handle_api_key_management(connection_hdl hdl, const json& data);
+    Authorization::ClientPermissions parse_client_permissions(const json& data);
+    void handle_alert_subscription(connection_hdl hdl, const json& data);
+    void push_alerts(const std::string& payload);
     
+    // Outbound helpers
+    void send_response(connection_hdl hdl, const json& response,
+                       websocketpp::frame::opcode::value opcode = websocketpp::frame::opcode::text);
+    void send_payload(connection_hdl hdl, std::string payload,
+                      websocketpp::frame::opcode::value opcode, bool unsolicited);
+    void handle_outbound_overflow(connection_hdl hdl, Server::connection_ptr con,
+                                  OutboundState& out, std::string payload,
+                                  websocketpp::frame::opcode::value opcode, bool unsolicited);
+    void send_and_close(connection_hdl hdl, const json& response,
+                        websocketpp::frame::opcode::value opcode, const std::string& reason);
+    void enqueue_outbound(OutboundState& out, std::string payload, websocketpp::frame::opcode::value opcode);
+    void set_reading_paused(OutboundState& out, Server::connection_ptr con, bool paused);
+    void release_outbound(connection_hdl hdl);
+    void schedule_flush(connection_hdl hdl, OutboundState& out);
+    void flush_outbound(connection_hdl hdl);
+    json get_outbound_stats();
+
     // Helper methods
-    bool is_admin(const std::string& api_key);
+    bool is_admin(const std::string& key_id);
     json get_connection_stats();
     json get_rate_limit_stats();
     json get_sensor_stats();
@@ -13,10 +13,23 @@ ADMIN_API_KEY = "admin-api-key-12345678901234567890123456789012"
 REGULAR_API_KEY = "test-api-key-12345678901234567890123456789012"
 INVALID_API_KEY = "invalid-api-key-12345678901234567890123456789012"
 
+# Responses not yet handed out, per connection; the server may coalesce
+# several responses into one {"batch": [...]} frame when a client falls behind
+pending_responses = {}
+
+async def receive_message(websocket):
+    pending = pending_responses.setdefault(websocket, [])
+    while not pending:
+        frame = json.loads(await websocket.recv())
+        if isinstance(frame, dict) and isinstance(frame.get("batch"), list):
+            pending.extend(frame["batch"])
+        else:
+            pending.append(frame)
+    return pending.pop(0)
+
 async def send_message(websocket, message):
     await websocket.send(json.dumps(message))
-    response = await websocket.recv()
-    return json.loads(response)
+    return await receive_message(websocket)
 
 async def test_authentication(websocket, api_key, expected_role=None):
     print(f"\nTesting Authentication with {'admin' if api_key == ADMIN_API_KEY else 'regular'} API key")
@@ -1,10 +1,34 @@
 #include "auth_handler.hpp"
-#include <regex>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <sstream>
+#include <stdexcept>
+#include <memory>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+namespace {
+
+std::string trim(std::string value) {
+    value.erase(0, value.find_first_not_of(" \t\n\r\f\v"));
+    value.erase(value.find_last_not_of(" \t\n\r\f\v") + 1);
+    return value;
+}
+
+}
+
+AuthHandler::AuthHandler() : table(std::make_shared<KeyTable>()) {
+    // Optional key file, also used by reload_from_file()
+    const char* env_key_file = std::getenv("API_KEYS_FILE");
+    if (env_key_file) {
+        key_file = env_key_file;
+        reload_from_file(key_file);
+        return;
+    }
 
-AuthHandler::AuthHandler() {
     // Get API keys from environment variable
+    std::set<Digest> loaded;
     const char* env_api_keys = std::getenv("VALID_API_KEYS");
     if (env_api_keys) {
         std::string api_keys_str(env_api_keys);
@@ -13,19 +37,17 @@ AuthHandler::AuthHandler() {
         
         // Split by comma
         while (std::getline(ss, api_key, ',')) {
-            // Trim whitespace
-            api_key.erase(0, api_key.find_first_not_of(" \t\n\r\f\v"));
-            api_key.erase(api_key.find_last_not_of(" \t\n\r\f\v") + 1);
-            
-            if (!api_key.empty()) {
-                add_api_key(api_key);
+            api_key = trim(api_key);
+            if (is_valid_api_key_format(api_key)) {
+                loaded.insert(digest_of(api_key));
             }
         }
     } else {
         // Fallback to default test keys
-        add_api_key("test-api-key-12345678901234567890123456789012");  // Regular user
-        add_api_key("admin-api-key-12345678901234567890123456789012"); // Admin user
+        loaded.insert(digest_of("test-api-key-12345678901234567890123456789012"));  // Regular user
+        loaded.insert(digest_of("admin-api-key-12345678901234567890123456789012")); // Admin user
     }
+    replace_keys(std::move(loaded));
 }
 
 bool AuthHandler::add_api_key(const std::string& api_key) {
@@ -33,13 +55,26 @@ bool AuthHandler::add_api_key(const std::string& api_key) {
         return false;
     }
     
-    std::lock_guard<std::mutex> lock(mutex);
-    return valid_api_keys.insert(api_key).second;
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (!digests.insert(digest_of(api_key)).second) {
+        return false;
+    }
+    publish();
+    return true;
 }
 
 bool AuthHandler::remove_api_key(const std::string& api_key) {
-    std::lock_guard<std::mutex> lock(mutex);
-    return valid_api_keys.erase(api_key) > 0;
+    Digest digest = digest_of(api_key);
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        if (digests.erase(digest) == 0) {
+            return false;
+        }
+        publish();
+    }
+    
+    notify_revoked({to_hex(digest)});
+    return true;
 }
 
 bool AuthHandler::validate_api_key(const std::string& api_key) const {
@@ -47,8 +82,66 @@ bool AuthHandler::validate_api_key(const std::string& api_key) const {
         return false;
     }
     
-    std::lock_guard<std::mutex> lock(mutex);
-    return valid_api_keys.find(api_key) != valid_api_keys.end();
+    const KeyTable& keys = table.current();
+    if (keys.count == 0) {
+        return false;
+    }
+    
+    Digest digest = digest_of(api_key);
+    for (size_t pos = slot_of(digest) & keys.mask; keys.slots[pos].used; pos = (pos + 1) & keys.mask) {
+        if (CRYPTO_memcmp(keys.slots[pos].digest.data(), digest.data(), digest.size()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t AuthHandler::reload_from_file(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot open API key file: " + path);
+    }
+    
+    std::set<Digest> loaded;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (is_valid_api_key_format(line)) {
+            loaded.insert(digest_of(line));
+        }
+    }
+    
+    return replace_keys(std::move(loaded));
+}
+
+size_t AuthHandler::reload_from_file() {
+    if (key_file.empty()) {
+        throw std::runtime_error("No API key file configured (API_KEYS_FILE)");
+    }
+    return reload_from_file(key_file);
+}
+
+size_t AuthHandler::key_count() const {
+    return table.load()->count;
+}
+
+std::string AuthHandler::key_id(const std::string& api_key) {
+    return to_hex(digest_of(api_key));
+}
+
+size_t AuthHandler::add_revocation_listener(RevocationListener listener) {
+    std::lock_guard<std::mutex> lock(listeners_mutex);
+    size_t listener_id = next_listener_id++;
+    revocation_listeners[listener_id] = std::move(listener);
+    return listener_id;
+}
+
+void AuthHandler::remove_revocation_listener(size_t listener_id) {
+    std::lock_guard<std::mutex> lock(listeners_mutex);
+    revocation_listeners.erase(listener_id);
 }
 
 bool AuthHandler::is_valid_api_key_format(const std::string& api_key) {
@@ -57,6 +150,104 @@ bool AuthHandler::is_valid_api_key_format(const std::string& api_key) {
     }
     
     // API key should only contain alphanumeric characters and hyphens
-    static const std::regex api_key_regex("^[a-zA-Z0-9-]+$");
-    return std::regex_match(api_key, api_key_regex);
+    for (char c : api_key) {
+        bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                     (c >= '0' && c <= '9') || c == '-';
+        if (!valid) {
+            return false;
+        }
+    }
+    return true;
+}
+
+AuthHandler::Digest AuthHandler::digest_of(const std::string& api_key) {
+    // Fetch the algorithm once and reuse a context per thread; implicit
+    // lookups would otherwise dominate validation cost
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    static EVP_MD* sha256 = EVP_MD_fetch(nullptr, "SHA256", nullptr);
+#else
+    static const EVP_MD* sha256 = EVP_sha256();
+#endif
+    thread_local std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    
+    Digest digest;
+    unsigned int length = 0;
+    if (!ctx || EVP_DigestInit_ex(ctx.get(), sha256, nullptr) != 1 ||
+        EVP_DigestUpdate(ctx.get(), api_key.data(), api_key.size()) != 1 ||
+        EVP_DigestFinal_ex(ctx.get(), digest.data(), &length) != 1) {
+        throw std::runtime_error("Failed to hash API key");
+    }
+    return digest;
+}
+
+std::string AuthHandler::to_hex(const Digest& digest) {
+    static const char hex_digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(digest.size() * 2);
+    for (unsigned char byte : digest) {
+        hex.push_back(hex_digits[byte >> 4]);
+        hex.push_back(hex_digits[byte & 0x0f]);
+    }
+    return hex;
+}
+
+size_t AuthHandler::slot_of(const Digest& digest) {
+    // The digest is already uniformly distributed, so its prefix is the hash
+    uint64_t prefix;
+    std::memcpy(&prefix, digest.data(), sizeof(prefix));
+    return static_cast<size_t>(prefix);
+}
+
+size_t AuthHandler::replace_keys(std::set<Digest> keys) {
+    std::set<std::string> revoked;
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        digests.swap(keys);
+        publish();
+        count = digests.size();
+        
+        // keys now holds the previous set
+        for (const auto& digest : keys) {
+            if (digests.find(digest) == digests.end()) {
+                revoked.insert(to_hex(digest));
+            }
+        }
+    }
+    
+    if (!revoked.empty()) {
+        notify_revoked(std::move(revoked));
+    }
+    return count;
+}
+
+void AuthHandler::publish() {
+    auto next = std::make_shared<KeyTable>();
+    
+    size_t capacity = 8;
+    while (capacity < digests.size() * 2) {
+        capacity <<= 1;
+    }
+    next->slots.resize(capacity);
+    next->mask = capacity - 1;
+    next->count = digests.size();
+    
+    for (const auto& digest : digests) {
+        size_t pos = slot_of(digest) & next->mask;
+        while (next->slots[pos].used) {
+            pos = (pos + 1) & next->mask;
+        }
+        next->slots[pos].used = true;
+        next->slots[pos].digest = digest;
+    }
+    
+    table.store(std::move(next));
+}
+
+void AuthHandler::notify_revoked(std::set<std::string> key_ids) {
+    auto revoked = std::make_shared<const std::set<std::string>>(std::move(key_ids));
+    std::lock_guard<std::mutex> lock(listeners_mutex);
+    for (const auto& entry : revocation_listeners) {
+        entry.second(revoked);
+    }
 } 
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "history_store.hpp"
+#include "sensor_data.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <pqxx/pqxx>
+
+namespace {
+
+const char* HISTORY_STATEMENT = "history_chunk";
+
+// Keyset pagination on (timestamp, id) keeps every chunk an index range scan
+const char* HISTORY_QUERY =
+    "SELECT id, \"timestamp\" AS cursor_ts, "
+    "       extract(epoch FROM \"timestamp\")::bigint AS epoch, "
+    "       type, value, unit, metadata::text AS metadata "
+    "FROM sensor_readings "
+    "WHERE sensor_id = $1 "
+    "  AND \"timestamp\" >= to_timestamp($2) AND \"timestamp\" < to_timestamp($3) "
+    "  AND (\"timestamp\", id) > ($4::timestamptz, $5) "
+    "ORDER BY \"timestamp\", id "
+    "LIMIT $6";
+
+std::string env_or(const char* name, const char* fallback) {
+    const char* value = std::getenv(name);
+    return value ? value : fallback;
+}
+
+}
+
+struct HistoryStore::Job {
+    Query query;
+    ChunkSink on_chunk;
+    ErrorSink on_error;
+    
+    // Keyset cursor, only touched by the worker currently running the job
+    std::string cursor_ts = "-infinity";
+    int64_t cursor_id = 0;
+    size_t total_rows = 0;
+    size_t total_bytes = 0;
+};
+
+namespace {
+
+HistoryStore::Chunk fetch_page(pqxx::connection& conn, HistoryStore::Job& job) {
+    const auto& query = job.query;
+    size_t remaining = query.max_rows - job.total_rows;
+    long long limit = static_cast<long long>(std::min(query.chunk_rows, remaining));
+    
+    pqxx::result result;
+    {
+        pqxx::read_transaction tx(conn);
+        result = tx.exec_prepared(HISTORY_STATEMENT, query.sensor_id,
+                                  static_cast<long long>(query.from), static_cast<long long>(query.to),
+                                  job.cursor_ts, static_cast<long long>(job.cursor_id), limit);
+        tx.commit();
+    }
+    
+    nlohmann::json rows = nlohmann::json::array();
+    for (const auto& row : result) {
+        SensorReading reading;
+        reading.sensor_id = query.sensor_id;
+        reading.type = row["type"].as<std::string>();
+        reading.value = row["value"].as<double>();
+        reading.unit = row["unit"].as<std::string>();
+        reading.timestamp = std::chrono::system_clock::from_time_t(row["epoch"].as<long long>());
+        if (!row["metadata"].is_null()) {
+            reading.metadata = nlohmann::json::parse(row["metadata"].c_str());
+        }
+        rows.push_back(reading);
+    }
+    
+    if (!result.empty()) {
+        const auto& tail = result[result.size() - 1];
+        job.cursor_ts = tail["cursor_ts"].as<std::string>();
+        job.cursor_id = tail["id"].as<long long>();
+    }
+    
+    HistoryStore::Chunk chunk;
+    chunk.rows = rows.dump();
+    chunk.row_count = result.size();
+    job.total_rows += chunk.row_count;
+    job.total_bytes += chunk.rows.size();
+    
+    bool exhausted = result.size() < static_cast<size_t>(limit);
+    bool over_limit = job.total_rows >= query.max_rows || job.total_bytes >= query.max_bytes;
+    chunk.last = exhausted || over_limit;
+    chunk.truncated = over_limit && !exhausted;
+    return chunk;
+}
+
+}
+
+HistoryStore::HistoryStore(std::string conninfo, size_t pool_size, size_t max_pending)
+    : conninfo(std::move(conninfo)), max_pending(max_pending) {
+    for (size_t i = 0; i < pool_size; ++i) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+HistoryStore::~HistoryStore() {
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        stopping = true;
+    }
+    jobs_ready.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+HistoryStore::JobHandle HistoryStore::submit(Query query, ChunkSink on_chunk, ErrorSink on_error) {
+    auto job = std::make_shared<Job>();
+    job->query = std::move(query);
+    job->on_chunk = std::move(on_chunk);
+    job->on_error = std::move(on_error);
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        if (stopping || jobs.size() >= max_pending) {
+            return nullptr;
+        }
+        jobs.push_back(job);
+    }
+    jobs_ready.notify_one();
+    return job;
+}
+
+void HistoryStore::resume(const JobHandle& job) {
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        if (stopping) {
+            return;
+        }
+        jobs.push_back(job);
+    }
+    jobs_ready.notify_one();
+}
+
+std::string HistoryStore::conninfo_from_env() {
+    return "host=" + env_or("POSTGRES_HOST", "localhost") +
+           " port=" + env_or("POSTGRES_PORT", "5432") +
+           " dbname=" + env_or("POSTGRES_DB", "iot_sensors") +
+           " user=" + env_or("POSTGRES_USER", "iot_user") +
+           " password=" + env_or("POSTGRES_PASSWORD", "");
+}
+
+void HistoryStore::worker_loop() {
+    // Each worker owns one connection, connected on first use
+    std::unique_ptr<pqxx::connection> conn;
+    
+    while (true) {
+        JobHandle job;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        
+        try {
+            if (!conn || !conn->is_open()) {
+                conn = std::make_unique<pqxx::connection>(conninfo);
+                conn->prepare(HISTORY_STATEMENT, HISTORY_QUERY);
+            }
+            
+            Chunk chunk = fetch_page(*conn, *job);
+            Flow flow = job->on_chunk(chunk);
+            
+            // Requeue rather than loop so other queries get a turn between pages
+            if (!chunk.last && flow == Flow::CONTINUE) {
+                resume(job);
+            }
+        } catch (const pqxx::broken_connection& e) {
+            conn.reset();
+            job->on_error("Database connection lost");
+        } catch (const std::exception& e) {
+            job->on_error(e.what());
+        }
+    }
+} 
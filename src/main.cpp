@@ -1,27 +1,63 @@
 #include "websocket_server.hpp"
+#include "sharded_server.hpp"
 #include <iostream>
 #include <csignal>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <pthread.h>
 
 WebSocketServer* server_ptr = nullptr;
+ShardedServer* sharded_server_ptr = nullptr;
 
-void signal_handler(int signal) {
+// SIGINT/SIGTERM are blocked in every thread and picked up here with sigwait,
+// so shutdown runs as ordinary code rather than inside a signal handler
+void wait_for_signals(sigset_t signals) {
+    int signal = 0;
+    if (sigwait(&signals, &signal) != 0) {
+        return;
+    }
+    
+    std::cout << "\nShutting down server..." << std::endl;
     if (server_ptr) {
-        std::cout << "\nShutting down server..." << std::endl;
         server_ptr->stop();
     }
+    if (sharded_server_ptr) {
+        sharded_server_ptr->stop();
+    }
 }
 
 int main() {
     try {
-        // Set up signal handling
-        server_ptr = new WebSocketServer();
-        std::signal(SIGINT, signal_handler);
-        std::signal(SIGTERM, signal_handler);
+        // Number of SO_REUSEPORT acceptor shards (1 keeps a single event loop)
+        size_t shard_count = 1;
+        if (const char* env_shards = std::getenv("SERVER_SHARDS")) {
+            shard_count = std::max(1, std::atoi(env_shards));
+        }
+        
+        // Set up signal handling before any worker threads start so they
+        // all inherit the blocked mask
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        
+        if (shard_count > 1) {
+            sharded_server_ptr = new ShardedServer(shard_count);
+        } else {
+            server_ptr = new WebSocketServer();
+        }
+        std::thread(wait_for_signals, signals).detach();
         
         // Run server on port 9002
         const uint16_t port = 9002;
         std::cout << "Starting IoT Sensor WebSocket server..." << std::endl;
-        server_ptr->run(port);
+        if (sharded_server_ptr) {
+            sharded_server_ptr->run(port);
+        } else {
+            server_ptr->run(port);
+        }
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -29,5 +65,6 @@ int main() {
     }
     
     delete server_ptr;
+    delete sharded_server_ptr;
     return 0;
-} 
\ No newline at end of file
+} 
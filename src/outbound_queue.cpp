@@ -0,0 +1,61 @@
+#include "outbound_queue.hpp"
+#include <cstdlib>
+
+OutboundLimits OutboundLimits::from_env() {
+    OutboundLimits limits;
+    
+    if (const char* env_bytes = std::getenv("OUTBOUND_MAX_BYTES")) {
+        limits.max_bytes = std::strtoull(env_bytes, nullptr, 10);
+    }
+    if (const char* env_messages = std::getenv("OUTBOUND_MAX_MESSAGES")) {
+        limits.max_messages = std::strtoull(env_messages, nullptr, 10);
+    }
+    if (const char* env_policy = std::getenv("OUTBOUND_POLICY")) {
+        std::string policy(env_policy);
+        if (policy == "drop") {
+            limits.policy = Policy::DROP;
+        } else if (policy == "disconnect") {
+            limits.policy = Policy::DISCONNECT;
+        } else {
+            limits.policy = Policy::PAUSE_READING;
+        }
+    }
+    
+    return limits;
+}
+
+void OutboundQueue::push(std::string payload, uint8_t opcode) {
+    bytes += payload.size();
+    pending.push_back(Entry{std::move(payload), opcode});
+}
+
+std::string OutboundQueue::take_batch(uint8_t& opcode) {
+    opcode = pending.front().opcode;
+    
+    size_t run = 0;
+    size_t run_bytes = 0;
+    while (run < pending.size() && pending[run].opcode == opcode) {
+        run_bytes += pending[run].payload.size();
+        run++;
+    }
+    
+    std::string batch;
+    if (run == 1) {
+        batch = std::move(pending.front().payload);
+    } else {
+        // Each payload is already a JSON document, so join them into an array
+        batch.reserve(run_bytes + run + 16);
+        batch += "{\"batch\":[";
+        for (size_t i = 0; i < run; ++i) {
+            if (i > 0) {
+                batch += ',';
+            }
+            batch += pending[i].payload;
+        }
+        batch += "]}";
+    }
+    
+    pending.erase(pending.begin(), pending.begin() + run);
+    bytes -= run_bytes;
+    return batch;
+} 
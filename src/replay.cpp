@@ -0,0 +1,267 @@
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+#include "traffic_capture.hpp"
+#include <iostream>
+#include <deque>
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cmath>
+
+using Client = websocketpp::client<websocketpp::config::asio_client>;
+using websocketpp::connection_hdl;
+
+// Replays a traffic capture against a server. Each captured connection is
+// reopened at its recorded time (scaled by the speed factor) and its frames
+// are sent in their original order.
+class Replayer {
+public:
+    Replayer(const std::string& capture_path, std::string uri, double speed)
+        : reader(capture_path), uri(std::move(uri)), speed(speed) {
+        client.clear_access_channels(websocketpp::log::alevel::all);
+        client.clear_error_channels(websocketpp::log::elevel::all);
+        client.init_asio();
+    }
+
+    void run() {
+        start = std::chrono::steady_clock::now();
+        has_next = reader.next(next_record);
+
+        client.start_perpetual();
+        pump();
+        client.run();
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Replayed " << connections_opened << " connections, "
+                  << frames_sent << " frames in " << elapsed << "s ("
+                  << (elapsed > 0 ? frames_sent / elapsed : 0) << " frames/s)" << std::endl;
+        std::cout << "Responses received: " << responses_received
+                  << ", failed connections: " << connections_failed
+                  << ", dropped frames: " << frames_dropped << std::endl;
+    }
+
+private:
+    struct ReplayConnection {
+        Client::connection_ptr con;
+        bool open = false;
+        bool close_pending = false;
+        std::deque<std::pair<websocketpp::frame::opcode::value, std::string>> pending;
+    };
+
+    static constexpr size_t BATCH_SIZE = 256;
+
+    CaptureReader reader;
+    CaptureReader::Record next_record;
+    bool has_next = false;
+    std::string uri;
+    double speed;   // 0 replays as fast as possible
+    Client client;
+    std::chrono::steady_clock::time_point start;
+    std::map<uint64_t, ReplayConnection> live;
+
+    uint64_t connections_opened = 0;
+    uint64_t connections_failed = 0;
+    uint64_t frames_sent = 0;
+    uint64_t frames_dropped = 0;
+    uint64_t responses_received = 0;
+
+    std::chrono::steady_clock::time_point due_time(const CaptureReader::Record& record) const {
+        auto offset = std::chrono::nanoseconds(static_cast<int64_t>(record.offset_ns / speed));
+        return start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+    }
+
+    void pump() {
+        size_t dispatched = 0;
+
+        while (has_next) {
+            if (speed > 0) {
+                auto due = due_time(next_record);
+                auto now = std::chrono::steady_clock::now();
+                if (due > now) {
+                    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count();
+                    client.set_timer(wait, [this](const websocketpp::lib::error_code& ec) {
+                        if (!ec) {
+                            pump();
+                        }
+                    });
+                    return;
+                }
+            } else if (dispatched == BATCH_SIZE) {
+                // Yield to the event loop so connections make progress
+                client.set_timer(0, [this](const websocketpp::lib::error_code& ec) {
+                    if (!ec) {
+                        pump();
+                    }
+                });
+                return;
+            }
+
+            dispatch(next_record);
+            dispatched++;
+            has_next = reader.next(next_record);
+        }
+
+        // Close anything the capture left open
+        std::vector<uint64_t> remaining;
+        for (const auto& entry : live) {
+            remaining.push_back(entry.first);
+        }
+        for (uint64_t connection_id : remaining) {
+            auto it = live.find(connection_id);
+            if (it != live.end()) {
+                request_close(it->first, it->second);
+            }
+        }
+        finish_if_done();
+    }
+
+    void dispatch(const CaptureReader::Record& record) {
+        switch (record.event) {
+            case TrafficCapture::Event::OPEN:
+                open_connection(record.connection_id);
+                break;
+            case TrafficCapture::Event::MESSAGE: {
+                auto it = live.find(record.connection_id);
+                if (it == live.end()) {
+                    frames_dropped++;
+                    break;
+                }
+                auto opcode = static_cast<websocketpp::frame::opcode::value>(record.opcode);
+                it->second.pending.emplace_back(opcode, record.payload);
+                flush(it->second);
+                break;
+            }
+            case TrafficCapture::Event::CLOSE: {
+                auto it = live.find(record.connection_id);
+                if (it != live.end()) {
+                    request_close(it->first, it->second);
+                }
+                break;
+            }
+        }
+    }
+
+    void open_connection(uint64_t connection_id) {
+        websocketpp::lib::error_code ec;
+        auto con = client.get_connection(uri, ec);
+        if (ec) {
+            connections_failed++;
+            return;
+        }
+
+        con->set_open_handler([this, connection_id](connection_hdl) {
+            auto it = live.find(connection_id);
+            if (it != live.end()) {
+                it->second.open = true;
+                flush(it->second);
+                if (it->second.close_pending) {
+                    request_close(it->first, it->second);
+                }
+            }
+        });
+        con->set_message_handler([this](connection_hdl, Client::message_ptr) {
+            responses_received++;
+        });
+        con->set_close_handler([this, connection_id](connection_hdl) {
+            live.erase(connection_id);
+            finish_if_done();
+        });
+        con->set_fail_handler([this, connection_id](connection_hdl) {
+            connections_failed++;
+            auto it = live.find(connection_id);
+            if (it != live.end()) {
+                frames_dropped += it->second.pending.size();
+                live.erase(it);
+            }
+            finish_if_done();
+        });
+
+        live[connection_id].con = con;
+        connections_opened++;
+        client.connect(con);
+    }
+
+    // Frames wait until the connection is open, preserving their order
+    void flush(ReplayConnection& connection) {
+        if (!connection.open) {
+            return;
+        }
+
+        while (!connection.pending.empty()) {
+            auto& frame = connection.pending.front();
+            if (connection.con->send(frame.second, frame.first)) {
+                frames_dropped++;
+            } else {
+                frames_sent++;
+            }
+            connection.pending.pop_front();
+        }
+    }
+
+    void request_close(uint64_t connection_id, ReplayConnection& connection) {
+        if (!connection.open) {
+            connection.close_pending = true;
+            return;
+        }
+
+        websocketpp::lib::error_code ec;
+        connection.con->close(websocketpp::close::status::normal, "Replay finished", ec);
+        if (ec) {
+            live.erase(connection_id);
+        }
+    }
+
+    void finish_if_done() {
+        if (!has_next && live.empty()) {
+            client.stop_perpetual();
+        }
+    }
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <capture-file> [--uri ws://host:port] [--speed N|max]" << std::endl;
+        return 1;
+    }
+
+    std::string capture_path = argv[1];
+    std::string uri = "ws://localhost:9002";
+    double speed = 1.0;
+
+    for (int i = 2; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (option != "--uri" && option != "--speed") {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << option << std::endl;
+            return 1;
+        }
+
+        std::string value = argv[i + 1];
+        if (option == "--uri") {
+            uri = value;
+        } else if (value == "max") {
+            speed = 0.0;
+        } else {
+            char* end = nullptr;
+            speed = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || !std::isfinite(speed) || speed <= 0) {
+                std::cerr << "Speed must be a finite number greater than 0 or \"max\"" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    try {
+        Replayer replayer(capture_path, uri, speed);
+        replayer.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,358 @@
+#include "rule_engine.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+const char* kind_to_string(AlertRule::Kind kind) {
+    switch (kind) {
+        case AlertRule::Kind::THRESHOLD: return "threshold";
+        case AlertRule::Kind::RATE_OF_CHANGE: return "rate_of_change";
+        case AlertRule::Kind::N_OF_M: return "n_of_m";
+    }
+    return "unknown";
+}
+
+AlertRule::Kind kind_from_string(const std::string& kind) {
+    if (kind == "threshold") return AlertRule::Kind::THRESHOLD;
+    if (kind == "rate_of_change") return AlertRule::Kind::RATE_OF_CHANGE;
+    if (kind == "n_of_m") return AlertRule::Kind::N_OF_M;
+    throw std::invalid_argument("Unknown rule kind: " + kind);
+}
+
+// Reads an n_of_m window size as a plain integer so out-of-range values are
+// rejected instead of wrapping when narrowed
+uint8_t window_size_from_json(const nlohmann::json& j, const char* key) {
+    int value = j.at(key).get<int>();
+    if (value < 1 || value > UINT8_MAX) {
+        throw std::invalid_argument(std::string("n_of_m ") + key + " out of range: " + std::to_string(value));
+    }
+    return static_cast<uint8_t>(value);
+}
+
+}
+
+void to_json(nlohmann::json& j, const AlertRule& rule) {
+    j = nlohmann::json{
+        {"id", rule.id},
+        {"kind", kind_to_string(rule.kind)}
+    };
+    
+    if (!rule.sensor_id.empty()) {
+        j["sensor_id"] = rule.sensor_id;
+    } else {
+        j["type"] = rule.type;
+    }
+    
+    if (rule.kind == AlertRule::Kind::RATE_OF_CHANGE) {
+        j["max_rate"] = rule.limit;
+    } else {
+        j[rule.above ? "above" : "below"] = rule.limit;
+    }
+    
+    if (rule.kind == AlertRule::Kind::N_OF_M) {
+        j["n"] = rule.n;
+        j["m"] = rule.m;
+    }
+}
+
+void from_json(const nlohmann::json& j, AlertRule& rule) {
+    rule.kind = kind_from_string(j.at("kind").get<std::string>());
+    rule.sensor_id = j.value("sensor_id", "");
+    rule.type = j.value("type", "");
+    
+    if (rule.kind == AlertRule::Kind::RATE_OF_CHANGE) {
+        j.at("max_rate").get_to(rule.limit);
+    } else if (j.contains("above")) {
+        rule.above = true;
+        j.at("above").get_to(rule.limit);
+    } else {
+        rule.above = false;
+        j.at("below").get_to(rule.limit);
+    }
+    
+    if (rule.kind == AlertRule::Kind::N_OF_M) {
+        rule.n = window_size_from_json(j, "n");
+        rule.m = window_size_from_json(j, "m");
+    }
+}
+
+void to_json(nlohmann::json& j, const RuleMatch& match) {
+    j = nlohmann::json{
+        {"rule_id", match.rule_id},
+        {"kind", kind_to_string(match.kind)},
+        {"sensor_id", match.sensor_id},
+        {"type", match.type},
+        {"value", match.value},
+        {"timestamp", std::chrono::system_clock::to_time_t(match.timestamp)}
+    };
+}
+
+void RuleEngine::RangeIndex::build(const std::vector<std::pair<std::string, Range>>& entries) {
+    size_t capacity = 8;
+    while (capacity < entries.size() * 2) {
+        capacity <<= 1;
+    }
+    
+    slots.assign(capacity, Slot{0, Range{0, 0}, 0});
+    keys.clear();
+    keys.reserve(entries.size());
+    mask = capacity - 1;
+    
+    for (const auto& entry : entries) {
+        uint64_t hash = std::hash<std::string>{}(entry.first);
+        uint64_t pos = hash & mask;
+        while (slots[pos].range.count != 0) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = Slot{hash, entry.second, static_cast<uint32_t>(keys.size())};
+        keys.push_back(entry.first);
+    }
+}
+
+const RuleEngine::Range* RuleEngine::RangeIndex::find(const std::string& key) const {
+    if (keys.empty()) {
+        return nullptr;
+    }
+    
+    uint64_t hash = std::hash<std::string>{}(key);
+    for (uint64_t pos = hash & mask; slots[pos].range.count != 0; pos = (pos + 1) & mask) {
+        if (slots[pos].hash == hash && keys[slots[pos].key_index] == key) {
+            return &slots[pos].range;
+        }
+    }
+    return nullptr;
+}
+
+RuleEngine::RuleEngine()
+    : snapshot(std::make_shared<Snapshot>()),
+      listeners(std::make_shared<ListenerList>()) {}
+
+uint32_t RuleEngine::add_rule(AlertRule rule) {
+    std::vector<AlertRule> batch;
+    batch.push_back(std::move(rule));
+    return add_rules(std::move(batch)).front();
+}
+
+std::vector<uint32_t> RuleEngine::add_rules(std::vector<AlertRule> new_rules) {
+    for (const auto& rule : new_rules) {
+        validate_rule(rule);
+    }
+    
+    std::lock_guard<std::mutex> lock(rules_mutex);
+    std::vector<uint32_t> ids;
+    ids.reserve(new_rules.size());
+    
+    for (auto& rule : new_rules) {
+        rule.id = next_rule_id++;
+        ids.push_back(rule.id);
+        rules[rule.id] = std::move(rule);
+    }
+    
+    recompile();
+    return ids;
+}
+
+bool RuleEngine::remove_rule(uint32_t rule_id) {
+    std::lock_guard<std::mutex> lock(rules_mutex);
+    if (rules.erase(rule_id) == 0) {
+        return false;
+    }
+    
+    recompile();
+    
+    // Rule ids are never reused, so this only frees memory
+    for (auto& stripe : state_stripes) {
+        std::lock_guard<std::mutex> stripe_lock(stripe.mutex);
+        for (auto it = stripe.sensors.begin(); it != stripe.sensors.end();) {
+            it->second.erase(rule_id);
+            it = it->second.empty() ? stripe.sensors.erase(it) : std::next(it);
+        }
+    }
+    return true;
+}
+
+std::vector<AlertRule> RuleEngine::list_rules() const {
+    std::lock_guard<std::mutex> lock(rules_mutex);
+    std::vector<AlertRule> result;
+    result.reserve(rules.size());
+    for (const auto& entry : rules) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+size_t RuleEngine::rule_count() const {
+    return snapshot.load()->rules.size();
+}
+
+void RuleEngine::validate_rule(const AlertRule& rule) {
+    if (rule.sensor_id.empty() == rule.type.empty()) {
+        throw std::invalid_argument("Rule must target exactly one of sensor_id or type");
+    }
+    if (std::isnan(rule.limit) || std::isinf(rule.limit)) {
+        throw std::invalid_argument("Rule limit must be a finite number");
+    }
+    if (rule.kind == AlertRule::Kind::N_OF_M &&
+        (rule.m == 0 || rule.m > MAX_WINDOW || rule.n == 0 || rule.n > rule.m)) {
+        throw std::invalid_argument("n_of_m rules require 1 <= n <= m <= 64");
+    }
+}
+
+void RuleEngine::recompile() {
+    auto compiled = std::make_shared<Snapshot>();
+    
+    // Group rules by key so each sensor and type maps to one contiguous range
+    std::vector<const AlertRule*> ordered;
+    ordered.reserve(rules.size());
+    for (const auto& entry : rules) {
+        ordered.push_back(&entry.second);
+    }
+    std::stable_sort(ordered.begin(), ordered.end(), [](const AlertRule* a, const AlertRule* b) {
+        return std::tie(a->sensor_id, a->type) < std::tie(b->sensor_id, b->type);
+    });
+    
+    compiled->rules.reserve(ordered.size());
+    
+    std::vector<std::pair<std::string, Range>> sensor_ranges;
+    std::vector<std::pair<std::string, Range>> type_ranges;
+    
+    for (const AlertRule* rule : ordered) {
+        uint32_t index = static_cast<uint32_t>(compiled->rules.size());
+        compiled->rules.push_back(CompiledRule{rule->limit, rule->id, rule->kind, rule->above, rule->n, rule->m});
+        
+        // Rules are sorted by key, so a new range starts whenever the key changes
+        auto& ranges = rule->sensor_id.empty() ? type_ranges : sensor_ranges;
+        const auto& key = rule->sensor_id.empty() ? rule->type : rule->sensor_id;
+        if (ranges.empty() || ranges.back().first != key) {
+            ranges.emplace_back(key, Range{index, 0});
+        }
+        ranges.back().second.count++;
+    }
+    
+    compiled->by_sensor.build(sensor_ranges);
+    compiled->by_type.build(type_ranges);
+    
+    snapshot.store(std::move(compiled));
+}
+
+void RuleEngine::evaluate(const SensorReading& reading, std::vector<RuleMatch>& matches) const {
+    const Snapshot& snap = snapshot.current();
+    if (snap.rules.empty()) {
+        return;
+    }
+    
+    int64_t seconds = std::chrono::duration_cast<std::chrono::seconds>(
+        reading.timestamp.time_since_epoch()).count();
+    
+    StateCursor states(*this, reading.sensor_id);
+    if (const Range* range = snap.by_sensor.find(reading.sensor_id)) {
+        evaluate_range(snap, *range, reading, seconds, states, matches);
+    }
+    if (const Range* range = snap.by_type.find(reading.type)) {
+        evaluate_range(snap, *range, reading, seconds, states, matches);
+    }
+}
+
+RuleEngine::StateCursor::StateCursor(const RuleEngine& engine, const std::string& sensor_id)
+    : engine(engine), sensor_id(sensor_id) {}
+
+RuleEngine::RuleState& RuleEngine::StateCursor::state_of(uint32_t rule_id) {
+    if (!states) {
+        StateStripe& stripe = engine.state_stripes[std::hash<std::string>{}(sensor_id) % STATE_STRIPES];
+        lock = std::unique_lock<std::mutex>(stripe.mutex);
+        auto it = stripe.sensors.find(sensor_id);
+        if (it == stripe.sensors.end()) {
+            it = stripe.sensors.emplace(sensor_id, std::unordered_map<uint32_t, RuleState>()).first;
+        }
+        states = &it->second;
+    }
+    return (*states)[rule_id];
+}
+
+void RuleEngine::evaluate_range(const Snapshot& snap, Range range, const SensorReading& reading, int64_t seconds,
+                                StateCursor& states, std::vector<RuleMatch>& matches) const {
+    const double value = reading.value;
+    
+    for (uint32_t i = range.begin; i < range.begin + range.count; ++i) {
+        const CompiledRule& rule = snap.rules[i];
+        bool matched = false;
+        
+        switch (rule.kind) {
+            case AlertRule::Kind::THRESHOLD:
+                matched = rule.above ? value > rule.limit : value < rule.limit;
+                break;
+            case AlertRule::Kind::RATE_OF_CHANGE: {
+                // Value and time are swapped together under the stripe lock
+                RuleState& state = states.state_of(rule.id);
+                if (state.last_time != UNSET_TIME && seconds > state.last_time) {
+                    double rate = std::fabs(value - state.last_value) / static_cast<double>(seconds - state.last_time);
+                    matched = rate > rule.limit;
+                }
+                state.last_value = value;
+                state.last_time = seconds;
+                break;
+            }
+            case AlertRule::Kind::N_OF_M: {
+                RuleState& state = states.state_of(rule.id);
+                uint64_t hit = (rule.above ? value > rule.limit : value < rule.limit) ? 1 : 0;
+                uint64_t mask = rule.m == MAX_WINDOW ? ~uint64_t(0) : (uint64_t(1) << rule.m) - 1;
+                state.window = ((state.window << 1) | hit) & mask;
+                matched = std::bitset<64>(state.window).count() >= rule.n;
+                break;
+            }
+        }
+        
+        if (matched) {
+            matches.push_back(RuleMatch{rule.id, rule.kind, reading.sensor_id, reading.type, value, reading.timestamp});
+        }
+    }
+}
+
+size_t RuleEngine::add_listener(Listener listener) {
+    std::lock_guard<std::mutex> lock(listeners_mutex);
+    size_t listener_id = next_listener_id++;
+    auto next = std::make_shared<ListenerList>(*listeners.load());
+    next->emplace_back(listener_id, std::move(listener));
+    listeners.store(std::move(next));
+    return listener_id;
+}
+
+void RuleEngine::remove_listener(size_t listener_id) {
+    std::shared_ptr<const ListenerList> previous;
+    {
+        std::lock_guard<std::mutex> lock(listeners_mutex);
+        previous = listeners.load();
+        auto next = std::make_shared<ListenerList>();
+        for (const auto& entry : *previous) {
+            if (entry.first != listener_id) {
+                next->push_back(entry);
+            }
+        }
+        listeners.store(std::move(next));
+    }
+    
+    // A publish that loaded the previous list may still be calling the
+    // removed listener; its owner can only go away once that has finished
+    while (previous.use_count() > 1) {
+        std::this_thread::yield();
+    }
+}
+
+void RuleEngine::publish(const std::vector<RuleMatch>& matches) {
+    auto current = listeners.load();
+    if (current->empty()) {
+        return;
+    }
+    
+    // Serialized once and shared by every listener
+    auto payload = std::make_shared<const std::string>(nlohmann::json{{"alerts", matches}}.dump());
+    for (const auto& entry : *current) {
+        entry.second(payload);
+    }
+} 
\ No newline at end of file
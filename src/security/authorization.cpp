@@ -2,15 +2,20 @@
 #include <algorithm>
 
 bool Authorization::add_client_permissions(const std::string& client_id, const ClientPermissions& permissions) {
-    std::lock_guard<std::mutex> lock(permissions_mutex);
+    std::unique_lock<std::shared_mutex> lock(permissions_mutex);
     client_permissions[client_id] = permissions;
     return true;
 }
 
+bool Authorization::remove_client_permissions(const std::string& client_id) {
+    std::unique_lock<std::shared_mutex> lock(permissions_mutex);
+    return client_permissions.erase(client_id) > 0;
+}
+
 bool Authorization::can_access_sensor(const std::string& client_id, 
                                    const std::string& sensor_id,
                                    Permission required_permission) {
-    std::lock_guard<std::mutex> lock(permissions_mutex);
+    std::shared_lock<std::shared_mutex> lock(permissions_mutex);
     
     auto it = client_permissions.find(client_id);
     if (it == client_permissions.end()) {
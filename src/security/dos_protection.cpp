@@ -1,12 +1,14 @@
 #include "security/dos_protection.hpp"
+#include <functional>
 
 DosProtection::DosProtection(unsigned int max_connections, unsigned int window_seconds)
     : max_connections(max_connections), window_seconds(window_seconds) {}
 
 bool DosProtection::allow_connection(const std::string& ip_address) {
-    std::lock_guard<std::mutex> lock(connection_mutex);
+    auto& stripe = stripe_for(ip_address);
+    std::lock_guard<std::mutex> lock(stripe.connection_mutex);
     
-    auto& history = connection_attempts[ip_address];
+    auto& history = stripe.connection_attempts[ip_address];
     cleanup_old_attempts(history);
     
     if (history.attempts.size() >= max_connections) {
@@ -17,6 +19,10 @@ bool DosProtection::allow_connection(const std::string& ip_address) {
     return true;
 }
 
+DosProtection::Stripe& DosProtection::stripe_for(const std::string& ip_address) {
+    return stripes[std::hash<std::string>{}(ip_address) % STRIPE_COUNT];
+}
+
 void DosProtection::cleanup_old_attempts(ConnectionHistory& history) {
     auto now = std::chrono::system_clock::now();
     while (!history.attempts.empty()) {
@@ -27,4 +33,4 @@ void DosProtection::cleanup_old_attempts(ConnectionHistory& history) {
             break;
         }
     }
-} 
\ No newline at end of file
+} 
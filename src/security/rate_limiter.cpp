@@ -1,14 +1,16 @@
 #include "security/rate_limiter.hpp"
+#include <functional>
 
 RateLimiter::RateLimiter(unsigned int max_requests, unsigned int window_seconds)
     : max_requests(max_requests), window_seconds(window_seconds) {}
 
 bool RateLimiter::check_rate_limit(const std::string& client_id) {
-    std::lock_guard<std::mutex> lock(quota_mutex);
-    cleanup_old_entries();
+    auto& stripe = stripe_for(client_id);
+    std::lock_guard<std::mutex> lock(stripe.quota_mutex);
+    cleanup_old_entries(stripe);
     
     auto now = std::chrono::system_clock::now();
-    auto& quota = client_quotas[client_id];
+    auto& quota = stripe.client_quotas[client_id];
     
     if (quota.requests == 0 || 
         std::chrono::duration_cast<std::chrono::seconds>(now - quota.window_start).count() >= window_seconds) {
@@ -25,13 +27,17 @@ bool RateLimiter::check_rate_limit(const std::string& client_id) {
     return true;
 }
 
-void RateLimiter::cleanup_old_entries() {
+RateLimiter::Stripe& RateLimiter::stripe_for(const std::string& client_id) {
+    return stripes[std::hash<std::string>{}(client_id) % STRIPE_COUNT];
+}
+
+void RateLimiter::cleanup_old_entries(Stripe& stripe) {
     auto now = std::chrono::system_clock::now();
-    for (auto it = client_quotas.begin(); it != client_quotas.end();) {
+    for (auto it = stripe.client_quotas.begin(); it != stripe.client_quotas.end();) {
         if (std::chrono::duration_cast<std::chrono::seconds>(now - it->second.window_start).count() >= window_seconds) {
-            it = client_quotas.erase(it);
+            it = stripe.client_quotas.erase(it);
         } else {
             ++it;
         }
     }
-} 
\ No newline at end of file
+} 
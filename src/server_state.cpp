@@ -0,0 +1,37 @@
+#include "server_state.hpp"
+#include <cstdlib>
+#include <algorithm>
+
+ServerState::ServerState() {
+    // Historical queries run on their own database connection pool
+    size_t history_pool_size = 4;
+    if (const char* env_pool_size = std::getenv("HISTORY_POOL_SIZE")) {
+        history_pool_size = std::max(1, std::atoi(env_pool_size));
+    }
+    history_store = std::make_unique<HistoryStore>(HistoryStore::conninfo_from_env(), history_pool_size);
+    capture = TrafficCapture::from_env();
+
+    // Permissions of removed keys go with them
+    auth_handler.add_revocation_listener(
+        [this](const std::shared_ptr<const std::set<std::string>>& revoked) {
+            for (const auto& key_id : *revoked) {
+                authorization.remove_client_permissions(key_id);
+            }
+        }
+    );
+
+    // Initialize admin permissions for test admin API key
+    Authorization::ClientPermissions admin_perms;
+    admin_perms.permissions.insert(Authorization::Permission::READ_SENSOR);
+    admin_perms.permissions.insert(Authorization::Permission::WRITE_SENSOR);
+    admin_perms.permissions.insert(Authorization::Permission::MANAGE_SENSORS);
+    admin_perms.permissions.insert(Authorization::Permission::ADMIN);
+    authorization.add_client_permissions(AuthHandler::key_id("admin-api-key-12345678901234567890123456789012"), admin_perms);
+
+    // Initialize regular user permissions
+    Authorization::ClientPermissions user_perms;
+    user_perms.permissions.insert(Authorization::Permission::READ_SENSOR);
+    user_perms.permissions.insert(Authorization::Permission::WRITE_SENSOR);
+    user_perms.allowed_sensor_ids = {"temp_sensor_001", "humidity_001"};
+    authorization.add_client_permissions(AuthHandler::key_id("test-api-key-12345678901234567890123456789012"), user_perms);
+} 
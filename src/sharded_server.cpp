@@ -0,0 +1,39 @@
+#include "sharded_server.hpp"
+#include <iostream>
+#include <thread>
+
+ShardedServer::ShardedServer(size_t shard_count)
+    : state(std::make_shared<ServerState>()) {
+    for (size_t i = 0; i < shard_count; ++i) {
+        auto shard = std::make_unique<WebSocketServer>(state);
+        shard->set_reuse_port(true);
+        shards.push_back(std::move(shard));
+    }
+}
+
+void ShardedServer::run(uint16_t port) {
+    std::vector<std::thread> threads;
+    threads.reserve(shards.size());
+    
+    for (auto& shard : shards) {
+        WebSocketServer* server = shard.get();
+        threads.emplace_back([server, port]() {
+            try {
+                server->run(port);
+            } catch (const std::exception& e) {
+                std::cerr << "Shard error: " << e.what() << std::endl;
+            }
+        });
+    }
+    
+    std::cout << "Running " << shards.size() << " server shards" << std::endl;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void ShardedServer::stop() {
+    for (auto& shard : shards) {
+        shard->stop();
+    }
+} 
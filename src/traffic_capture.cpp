@@ -0,0 +1,233 @@
+#include "traffic_capture.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr char TrafficCapture::MAGIC[8];
+constexpr uint32_t TrafficCapture::MAX_PAYLOAD_SIZE;
+
+TrafficCapture::TrafficCapture(const std::string& path)
+    : file(open_private(path)), start(std::chrono::steady_clock::now()) {
+    if (!file) {
+        throw std::runtime_error("Cannot open capture file: " + path);
+    }
+    
+    uint64_t start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::fwrite(MAGIC, 1, sizeof(MAGIC), file);
+    std::fwrite(&start_ns, sizeof(start_ns), 1, file);
+    
+    for (auto& stripe : stripes) {
+        stripe.buffer.reserve(FLUSH_THRESHOLD);
+    }
+    writer = std::thread([this]() { writer_loop(); });
+}
+
+TrafficCapture::~TrafficCapture() {
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        stopping = true;
+    }
+    flush_ready.notify_one();
+    writer.join();
+    std::fclose(file);
+}
+
+uint64_t TrafficCapture::next_connection_id() {
+    return connection_ids.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TrafficCapture::record(Event event, uint64_t connection_id, uint8_t opcode, const std::string& payload) {
+    RecordHeader header;
+    header.connection_id = connection_id;
+    header.payload_size = static_cast<uint32_t>(payload.size());
+    header.event = static_cast<uint8_t>(event);
+    header.opcode = opcode;
+    header.reserved = 0;
+    
+    Stripe& stripe = stripe_for_thread();
+    bool flush = false;
+    {
+        // Timestamp under the lock so offsets within a stripe never go backwards
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        if (stripe.buffer.size() + sizeof(header) + payload.size() > MAX_STRIPE_BYTES) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        header.offset_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        stripe.buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        stripe.buffer.append(payload);
+        flush = stripe.buffer.size() >= FLUSH_THRESHOLD;
+    }
+    if (flush) {
+        flush_requested.store(true, std::memory_order_relaxed);
+        flush_ready.notify_one();
+    }
+}
+
+uint64_t TrafficCapture::dropped_records() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+std::FILE* TrafficCapture::open_private(const std::string& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    
+    // An existing file keeps its mode on O_CREAT, so tighten it explicitly
+    std::FILE* opened = nullptr;
+    if (::fchmod(fd, 0600) == 0) {
+        opened = ::fdopen(fd, "wb");
+    }
+    if (!opened) {
+        ::close(fd);
+    }
+    return opened;
+}
+
+TrafficCapture::Stripe& TrafficCapture::stripe_for_thread() {
+    thread_local size_t stripe_index = SIZE_MAX;
+    if (stripe_index == SIZE_MAX) {
+        stripe_index = next_stripe.fetch_add(1, std::memory_order_relaxed) % STRIPE_COUNT;
+    }
+    return stripes[stripe_index];
+}
+
+std::unique_ptr<TrafficCapture> TrafficCapture::from_env() {
+    const char* env_path = std::getenv("TRAFFIC_CAPTURE_FILE");
+    if (!env_path || !*env_path) {
+        return nullptr;
+    }
+    return std::make_unique<TrafficCapture>(env_path);
+}
+
+void TrafficCapture::writer_loop() {
+    // Records timestamped after the current cutoff, held for the next round
+    std::string held;
+    
+    while (true) {
+        bool done;
+        {
+            // Write at least every 100ms so a crash loses little traffic
+            std::unique_lock<std::mutex> lock(writer_mutex);
+            flush_ready.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+                return stopping || flush_requested.load(std::memory_order_relaxed);
+            });
+            flush_requested.store(false, std::memory_order_relaxed);
+            done = stopping;
+        }
+        
+        uint64_t cutoff_ns = done ? UINT64_MAX : std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        write_merged(held, cutoff_ns);
+        
+        if (done) {
+            return;
+        }
+    }
+}
+
+void TrafficCapture::write_merged(std::string& held, uint64_t cutoff_ns) {
+    // Records are timestamped under their stripe's lock, so once every stripe
+    // has been swapped out after the cutoff, nothing older than the cutoff can
+    // still arrive. Writing only up to the cutoff keeps the file in order.
+    std::vector<std::string> inputs;
+    inputs.reserve(STRIPE_COUNT + 1);
+    inputs.push_back(std::move(held));
+    held.clear();
+    for (auto& stripe : stripes) {
+        std::string taken;
+        {
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            taken.swap(stripe.buffer);
+        }
+        if (!taken.empty()) {
+            inputs.push_back(std::move(taken));
+        }
+    }
+    
+    struct Entry {
+        uint64_t offset_ns;
+        const char* data;
+        size_t size;
+    };
+    std::vector<Entry> entries;
+    for (const auto& input : inputs) {
+        for (size_t pos = 0; pos < input.size();) {
+            RecordHeader header;
+            std::memcpy(&header, input.data() + pos, sizeof(header));
+            size_t size = sizeof(header) + header.payload_size;
+            entries.push_back(Entry{header.offset_ns, input.data() + pos, size});
+            pos += size;
+        }
+    }
+    
+    // Stable, so records of one connection keep their order on equal offsets
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.offset_ns < b.offset_ns;
+    });
+    
+    for (const auto& entry : entries) {
+        if (entry.offset_ns <= cutoff_ns) {
+            std::fwrite(entry.data, 1, entry.size, file);
+        } else {
+            held.append(entry.data, entry.size);
+        }
+    }
+    std::fflush(file);
+}
+
+CaptureReader::CaptureReader(const std::string& path) : file(std::fopen(path.c_str(), "rb")), path(path) {
+    if (!file) {
+        throw std::runtime_error("Cannot open capture file: " + path);
+    }
+    
+    char magic[sizeof(TrafficCapture::MAGIC)];
+    uint64_t start_ns;
+    if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        std::memcmp(magic, TrafficCapture::MAGIC, sizeof(magic)) != 0 ||
+        std::fread(&start_ns, sizeof(start_ns), 1, file) != 1) {
+        std::fclose(file);
+        throw std::runtime_error("Not a traffic capture file: " + path);
+    }
+}
+
+CaptureReader::~CaptureReader() {
+    std::fclose(file);
+}
+
+bool CaptureReader::next(Record& record) {
+    TrafficCapture::RecordHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1) {
+        return false;
+    }
+    
+    bool known_event = header.event == static_cast<uint8_t>(TrafficCapture::Event::OPEN) ||
+                       header.event == static_cast<uint8_t>(TrafficCapture::Event::MESSAGE) ||
+                       header.event == static_cast<uint8_t>(TrafficCapture::Event::CLOSE);
+    if (!known_event || header.payload_size > TrafficCapture::MAX_PAYLOAD_SIZE) {
+        throw std::runtime_error("Corrupt traffic capture file: " + path);
+    }
+    if (header.offset_ns < last_offset_ns) {
+        throw std::runtime_error("Traffic capture file out of order: " + path);
+    }
+    last_offset_ns = header.offset_ns;
+    
+    record.event = static_cast<TrafficCapture::Event>(header.event);
+    record.offset_ns = header.offset_ns;
+    record.connection_id = header.connection_id;
+    record.opcode = header.opcode;
+    record.payload.resize(header.payload_size);
+    if (header.payload_size > 0 &&
+        std::fread(&record.payload[0], 1, header.payload_size, file) != header.payload_size) {
+        return false;
+    }
+    return true;
+}
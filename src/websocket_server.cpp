@@ -1,8 +1,16 @@
 #include "websocket_server.hpp"
 #include <iostream>
 #include <chrono>
+#include <algorithm>
+#include <sys/socket.h>
 
-WebSocketServer::WebSocketServer() {
+WebSocketServer::WebSocketServer(std::shared_ptr<ServerState> shared_state)
+    : state(shared_state ? std::move(shared_state) : std::make_shared<ServerState>()),
+      auth_handler(state->auth_handler),
+      rate_limiter(state->rate_limiter),
+      authorization(state->authorization),
+      dos_protection(state->dos_protection),
+      outbound_limits(OutboundLimits::from_env()) {
     // Set logging settings
     server.set_access_channels(websocketpp::log::alevel::all);
     server.clear_access_channels(websocketpp::log::alevel::frame_payload);
@@ -29,24 +37,56 @@ WebSocketServer::WebSocketServer() {
         }
     );
 
-    // Initialize admin permissions for test admin API key
-    Authorization::ClientPermissions admin_perms;
-    admin_perms.permissions.insert(Authorization::Permission::READ_SENSOR);
-    admin_perms.permissions.insert(Authorization::Permission::WRITE_SENSOR);
-    admin_perms.permissions.insert(Authorization::Permission::MANAGE_SENSORS);
-    admin_perms.permissions.insert(Authorization::Permission::ADMIN);
-    authorization.add_client_permissions("admin-api-key-12345678901234567890123456789012", admin_perms);
+    // Sessions authenticated with a removed key are closed on this shard's
+    // event loop, whichever shard removed it
+    revocation_listener_id = auth_handler.add_revocation_listener(
+        [this](const std::shared_ptr<const std::set<std::string>>& revoked) {
+            websocketpp::lib::asio::post(server.get_io_service(), [this, revoked]() {
+                close_revoked_sessions(*revoked);
+            });
+        }
+    );
+
+    // Rule matches from any shard are delivered to this shard's subscribers
+    // on its own event loop
+    alert_listener_id = state->rule_engine.add_listener(
+        [this](const std::shared_ptr<const std::string>& payload) {
+            if (alert_subscriber_count.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+            websocketpp::lib::asio::post(server.get_io_service(), [this, payload]() {
+                push_alerts(*payload);
+            });
+        }
+    );
+}
 
-    // Initialize regular user permissions
-    Authorization::ClientPermissions user_perms;
-    user_perms.permissions.insert(Authorization::Permission::READ_SENSOR);
-    user_perms.permissions.insert(Authorization::Permission::WRITE_SENSOR);
-    user_perms.allowed_sensor_ids = {"temp_sensor_001", "humidity_001"};
-    authorization.add_client_permissions("test-api-key-12345678901234567890123456789012", user_perms);
+WebSocketServer::~WebSocketServer() {
+    auth_handler.remove_revocation_listener(revocation_listener_id);
+    state->rule_engine.remove_listener(alert_listener_id);
+    while (!history_streams.empty()) {
+        cancel_history_streams(history_streams.begin()->first);
+    }
 }
 
 void WebSocketServer::run(uint16_t port) {
     server.set_reuse_addr(true);
+    if (reuse_port) {
+        server.set_tcp_pre_bind_handler(
+            [](websocketpp::lib::shared_ptr<websocketpp::lib::asio::ip::tcp::acceptor> acceptor)
+                -> websocketpp::lib::error_code {
+                using reuse_port_option =
+                    websocketpp::lib::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+                websocketpp::lib::asio::error_code ec;
+                acceptor->set_option(reuse_port_option(true), ec);
+                if (ec) {
+                    return websocketpp::transport::asio::error::make_error_code(
+                        websocketpp::transport::asio::error::pass_through);
+                }
+                return websocketpp::lib::error_code();
+            }
+        );
+    }
     server.listen(port);
     server.start_accept();
     
@@ -55,7 +95,16 @@ void WebSocketServer::run(uint16_t port) {
 }
 
 void WebSocketServer::stop() {
-    server.stop_listening();
+    // The acceptor belongs to the thread running this server's event loop,
+    // so stop listening from there rather than from the caller's thread
+    websocketpp::lib::asio::post(server.get_io_service(), [this]() {
+        websocketpp::lib::error_code ec;
+        server.stop_listening(ec);
+    });
+}
+
+void WebSocketServer::set_reuse_port(bool enable) {
+    reuse_port = enable;
 }
 
 std::string WebSocketServer::get_client_ip(connection_hdl hdl) {
@@ -64,16 +113,21 @@ std::string WebSocketServer::get_client_ip(connection_hdl hdl) {
 }
 
 void WebSocketServer::on_message(connection_hdl hdl, MessagePtr msg) {
+    if (state->capture) {
+        state->capture->record(TrafficCapture::Event::MESSAGE, capture_ids[hdl],
+                               static_cast<uint8_t>(msg->get_opcode()), msg->get_payload());
+    }
+    
     try {
         std::string client_ip = get_client_ip(hdl);
         
         // Check rate limit
         if (!rate_limiter.check_rate_limit(client_ip)) {
-            server.send(hdl, json{
+            send_response(hdl, json{
                 {"status", "error"},
                 {"message", "Rate limit exceeded",
                 "error_code", "RATE_LIMIT_EXCEEDED"}
-            }.dump(), msg->get_opcode());
+            }, msg->get_opcode());
             return;
         }
 
@@ -83,38 +137,48 @@ void WebSocketServer::on_message(connection_hdl hdl, MessagePtr msg) {
         if (data.contains("api_key")) {
             std::string api_key = data["api_key"];
             if (validate_api_key(api_key)) {
-                connections[hdl] = api_key;
+                if (connections.find(hdl) == connections.end()) {
+                    state->active_connections++;
+                }
+                std::string key_id = AuthHandler::key_id(api_key);
+                connections[hdl] = key_id;
                 json response = {{"status", "authenticated"}};
-                if (is_admin(api_key)) {
+                if (is_admin(key_id)) {
                     response["role"] = "admin";
                 }
-                server.send(hdl, response.dump(), msg->get_opcode());
+                send_response(hdl, response, msg->get_opcode());
             } else {
-                server.send(hdl, json{
+                send_and_close(hdl, json{
                     {"status", "error"},
                     {"message", "Invalid API key"},
                     {"error_code", "INVALID_API_KEY"}
-                }.dump(), msg->get_opcode());
-                server.close(hdl, websocketpp::close::status::policy_violation, "Invalid API key");
+                }, msg->get_opcode(), "Invalid API key");
             }
             return;
         }
         
         // Check if client is authenticated
         if (connections.find(hdl) == connections.end()) {
-            server.send(hdl, json{
+            send_and_close(hdl, json{
                 {"status", "error"},
                 {"message", "Not authenticated"},
                 {"error_code", "NOT_AUTHENTICATED"}
-            }.dump(), msg->get_opcode());
-            server.close(hdl, websocketpp::close::status::policy_violation, "Not authenticated");
+            }, msg->get_opcode(), "Not authenticated");
             return;
         }
 
-        std::string api_key = connections[hdl];
+        std::string key_id = connections[hdl];
 
         // Handle admin requests
         if (data.contains("admin")) {
+            if (!is_admin(key_id)) {
+                send_response(hdl, json{
+                    {"status", "error"},
+                    {"message", "Admin permission required"},
+                    {"error_code", "ADMIN_REQUIRED"}
+                }, msg->get_opcode());
+                return;
+            }
             handle_admin_request(hdl, data["admin"]);
             return;
         }
@@ -125,81 +189,537 @@ void WebSocketServer::on_message(connection_hdl hdl, MessagePtr msg) {
             return;
         }
         
+        // Handle historical queries
+        if (data.contains("history")) {
+            handle_history_request(hdl, data["history"]);
+            return;
+        }
+        
         // Unknown request type
-        server.send(hdl, json{
+        send_response(hdl, json{
             {"status", "error"},
             {"message", "Unknown request type"},
             {"error_code", "UNKNOWN_REQUEST"}
-        }.dump(), msg->get_opcode());
+        }, msg->get_opcode());
         
     } catch (const json::exception& e) {
-        server.send(hdl, json{
+        send_response(hdl, json{
             {"status", "error"},
             {"message", "Invalid JSON format"},
             {"error_code", "INVALID_JSON"}
-        }.dump(), msg->get_opcode());
+        }, msg->get_opcode());
     } catch (const std::exception& e) {
-        server.send(hdl, json{
+        send_response(hdl, json{
             {"status", "error"},
             {"message", std::string("Internal server error: ") + e.what()},
             {"error_code", "INTERNAL_ERROR"}
-        }.dump(), msg->get_opcode());
+        }, msg->get_opcode());
     }
 }
 
 void WebSocketServer::on_open(connection_hdl hdl) {
     std::string client_ip = get_client_ip(hdl);
     
+    if (state->capture) {
+        uint64_t capture_id = state->capture->next_connection_id();
+        capture_ids[hdl] = capture_id;
+        state->capture->record(TrafficCapture::Event::OPEN, capture_id, 0, client_ip);
+    }
+    
     if (!dos_protection.allow_connection(client_ip)) {
         server.close(hdl, websocketpp::close::status::policy_violation, 
                     "Too many connection attempts");
         return;
     }
     
+    state->total_connections++;
     std::cout << "New connection opened from " << client_ip << std::endl;
 }
 
 void WebSocketServer::on_close(connection_hdl hdl) {
-    connections.erase(hdl);
+    if (state->capture) {
+        auto it = capture_ids.find(hdl);
+        if (it != capture_ids.end()) {
+            state->capture->record(TrafficCapture::Event::CLOSE, it->second, 0, "");
+            capture_ids.erase(it);
+        }
+    }
+    
+    if (connections.erase(hdl) > 0) {
+        state->active_connections--;
+    }
+    release_outbound(hdl);
+    cancel_history_streams(hdl);
+    if (alert_subscribers.erase(hdl) > 0) {
+        alert_subscriber_count--;
+    }
     std::cout << "Connection closed from " << get_client_ip(hdl) << std::endl;
 }
 
+void WebSocketServer::send_response(connection_hdl hdl, const json& response,
+                                    websocketpp::frame::opcode::value opcode) {
+    send_payload(hdl, response.dump(), opcode, false);
+}
+
+void WebSocketServer::send_payload(connection_hdl hdl, std::string payload,
+                                   websocketpp::frame::opcode::value opcode, bool unsolicited) {
+    websocketpp::lib::error_code ec;
+    auto con = server.get_con_from_hdl(hdl, ec);
+    if (ec || con->get_state() != websocketpp::session::state::open) {
+        return;
+    }
+    
+    auto& out = outbound[hdl];
+    size_t buffered = con->get_buffered_amount();
+    
+    // Enforce the per-connection byte and message limits
+    if (buffered + out.queue.pending_bytes() + payload.size() > outbound_limits.max_bytes ||
+        out.queue.pending_messages() >= outbound_limits.max_messages) {
+        handle_outbound_overflow(hdl, con, out, std::move(payload), opcode, unsolicited);
+        return;
+    }
+    
+    // Client is behind: hold the response back and coalesce it with others
+    if (!out.queue.empty() || buffered >= outbound_limits.coalesce_threshold_bytes) {
+        enqueue_outbound(out, std::move(payload), opcode);
+        schedule_flush(hdl, out);
+        return;
+    }
+    
+    con->send(payload, opcode);
+}
+
+void WebSocketServer::send_and_close(connection_hdl hdl, const json& response,
+                                     websocketpp::frame::opcode::value opcode, const std::string& reason) {
+    websocketpp::lib::error_code ec;
+    auto con = server.get_con_from_hdl(hdl, ec);
+    if (ec) {
+        return;
+    }
+    
+    // Bypass coalescing: the error has to be written before the close frame
+    con->send(response.dump(), opcode);
+    con->close(websocketpp::close::status::policy_violation, reason, ec);
+}
+
+void WebSocketServer::enqueue_outbound(OutboundState& out, std::string payload,
+                                       websocketpp::frame::opcode::value opcode) {
+    state->outbound_queued_messages++;
+    state->outbound_queued_bytes += payload.size();
+    out.queue.push(std::move(payload), static_cast<uint8_t>(opcode));
+}
+
+void WebSocketServer::set_reading_paused(OutboundState& out, Server::connection_ptr con, bool paused) {
+    if (out.reading_paused == paused) {
+        return;
+    }
+    
+    out.reading_paused = paused;
+    if (paused) {
+        con->pause_reading();
+        state->outbound_paused_connections++;
+    } else {
+        con->resume_reading();
+        state->outbound_paused_connections--;
+    }
+}
+
+void WebSocketServer::release_outbound(connection_hdl hdl) {
+    auto it = outbound.find(hdl);
+    if (it == outbound.end()) {
+        return;
+    }
+    
+    // Anything still held back is discarded with the connection
+    const auto& out = it->second;
+    state->outbound_queued_messages -= out.queue.pending_messages();
+    state->outbound_queued_bytes -= out.queue.pending_bytes();
+    if (out.reading_paused) {
+        state->outbound_paused_connections--;
+    }
+    outbound.erase(it);
+}
+
+void WebSocketServer::handle_outbound_overflow(connection_hdl hdl, Server::connection_ptr con,
+                                               OutboundState& out, std::string payload,
+                                               websocketpp::frame::opcode::value opcode, bool unsolicited) {
+    // Pushed messages are not throttled by pausing reads, so always drop them
+    if (unsolicited && outbound_limits.policy == OutboundLimits::Policy::PAUSE_READING) {
+        state->outbound_dropped++;
+        return;
+    }
+    
+    switch (outbound_limits.policy) {
+        case OutboundLimits::Policy::PAUSE_READING:
+            // Stop reading requests until the client drains; the queue stays
+            // bounded because responses are only produced by requests
+            set_reading_paused(out, con, true);
+            enqueue_outbound(out, std::move(payload), opcode);
+            schedule_flush(hdl, out);
+            break;
+        case OutboundLimits::Policy::DROP:
+            state->outbound_dropped++;
+            break;
+        case OutboundLimits::Policy::DISCONNECT:
+            state->outbound_disconnects++;
+            con->close(websocketpp::close::status::policy_violation, "Outbound buffer limit exceeded");
+            break;
+    }
+}
+
+void WebSocketServer::schedule_flush(connection_hdl hdl, OutboundState& out) {
+    if (out.flush_scheduled) {
+        return;
+    }
+    
+    out.flush_scheduled = true;
+    server.set_timer(outbound_limits.flush_interval_ms,
+        [this, hdl](const websocketpp::lib::error_code& ec) {
+            if (!ec) {
+                flush_outbound(hdl);
+            }
+        }
+    );
+}
+
+void WebSocketServer::flush_outbound(connection_hdl hdl) {
+    auto it = outbound.find(hdl);
+    if (it == outbound.end()) {
+        return;
+    }
+    
+    auto& out = it->second;
+    out.flush_scheduled = false;
+    
+    websocketpp::lib::error_code ec;
+    auto con = server.get_con_from_hdl(hdl, ec);
+    if (ec || con->get_state() != websocketpp::session::state::open) {
+        release_outbound(hdl);
+        return;
+    }
+    
+    // Send everything held back, batched by opcode, once the socket has drained
+    if (con->get_buffered_amount() < outbound_limits.coalesce_threshold_bytes) {
+        while (!out.queue.empty()) {
+            size_t messages = out.queue.pending_messages();
+            size_t bytes = out.queue.pending_bytes();
+            uint8_t opcode = 0;
+            std::string batch = out.queue.take_batch(opcode);
+            state->outbound_queued_messages -= messages - out.queue.pending_messages();
+            state->outbound_queued_bytes -= bytes - out.queue.pending_bytes();
+            con->send(batch, static_cast<websocketpp::frame::opcode::value>(opcode));
+        }
+    }
+    
+    // Resume reading once the backlog falls below half the byte limit
+    if (out.reading_paused && out.queue.empty() &&
+        con->get_buffered_amount() < outbound_limits.max_bytes / 2) {
+        set_reading_paused(out, con, false);
+    }
+    
+    if (!out.queue.empty() || out.reading_paused) {
+        schedule_flush(hdl, out);
+    }
+}
+
 bool WebSocketServer::validate_api_key(const std::string& api_key) {
     return auth_handler.validate_api_key(api_key);
 }
 
+void WebSocketServer::close_revoked_sessions(const std::set<std::string>& revoked) {
+    std::vector<connection_hdl> revoked_sessions;
+    for (const auto& entry : connections) {
+        if (revoked.count(entry.second)) {
+            revoked_sessions.push_back(entry.first);
+        }
+    }
+    
+    // on_close cleans up once the close handshake completes
+    for (const auto& hdl : revoked_sessions) {
+        websocketpp::lib::error_code ec;
+        server.close(hdl, websocketpp::close::status::policy_violation, "API key revoked", ec);
+    }
+}
+
 void WebSocketServer::handle_sensor_data(connection_hdl hdl, const json& data) {
     try {
         SensorReading reading = data.get<SensorReading>();
-        std::string api_key = connections[hdl];
+        std::string key_id = connections[hdl];
         
         // Check authorization
-        if (!authorization.can_access_sensor(api_key, reading.sensor_id, Authorization::Permission::WRITE_SENSOR)) {
-            server.send(hdl, json{
+        if (!authorization.can_access_sensor(key_id, reading.sensor_id, Authorization::Permission::WRITE_SENSOR)) {
+            send_response(hdl, json{
                 {"status", "error"},
                 {"message", "Unauthorized access to sensor"}
-            }.dump(), websocketpp::frame::opcode::text);
+            }, websocketpp::frame::opcode::text);
             return;
         }
         
         if (SensorData::validate_sensor_reading(reading)) {
             // Process the valid sensor reading
-            server.send(hdl, json{{"status", "success"}, {"message", "Sensor data received"}}.dump(), 
-                       websocketpp::frame::opcode::text);
+            rule_matches.clear();
+            state->rule_engine.evaluate(reading, rule_matches);
+            if (!rule_matches.empty()) {
+                state->rule_engine.publish(rule_matches);
+            }
+            send_response(hdl, json{{"status", "success"}, {"message", "Sensor data received"}},
+                          websocketpp::frame::opcode::text);
         } else {
-            server.send(hdl, json{
+            send_response(hdl, json{
                 {"status", "error"},
                 {"message", SensorData::get_error_message(reading)}
-            }.dump(), websocketpp::frame::opcode::text);
+            }, websocketpp::frame::opcode::text);
         }
     } catch (const json::exception& e) {
-        server.send(hdl, json{{"error", "Invalid sensor data format"}}.dump(), 
-                   websocketpp::frame::opcode::text);
+        send_response(hdl, json{{"error", "Invalid sensor data format"}},
+                      websocketpp::frame::opcode::text);
     }
 }
 
-bool WebSocketServer::is_admin(const std::string& api_key) {
-    return authorization.can_access_sensor(api_key, "", Authorization::Permission::ADMIN);
+void WebSocketServer::handle_history_request(connection_hdl hdl, const json& data) {
+    std::string sensor_id = data["sensor_id"];
+    std::string key_id = connections[hdl];
+    std::string request_id = data.value("request_id", json()).dump();
+    
+    // Check authorization
+    if (!authorization.can_access_sensor(key_id, sensor_id, Authorization::Permission::READ_SENSOR)) {
+        send_response(hdl, json{
+            {"status", "error"},
+            {"message", "Unauthorized access to sensor"},
+            {"error_code", "UNAUTHORIZED"}
+        }, websocketpp::frame::opcode::text);
+        return;
+    }
+    
+    auto& streams = history_streams[hdl];
+    if (streams.size() >= MAX_HISTORY_STREAMS) {
+        send_response(hdl, json{
+            {"status", "error"},
+            {"message", "Too many concurrent history requests"},
+            {"error_code", "HISTORY_BUSY"}
+        }, websocketpp::frame::opcode::text);
+        return;
+    }
+    
+    HistoryStore::Query query;
+    query.sensor_id = sensor_id;
+    query.from = data.value("from", int64_t(0));
+    query.to = data.value("to", static_cast<int64_t>(
+        std::chrono::system_clock::to_time_t(std::chrono::system_clock::now())) + 1);
+    query.max_rows = std::max<size_t>(1, std::min(data.value("limit", MAX_HISTORY_ROWS), MAX_HISTORY_ROWS));
+    query.max_bytes = MAX_HISTORY_BYTES;
+    
+    auto stream = std::make_shared<HistoryStream>();
+    stream->hdl = hdl;
+    stream->request_id = request_id;
+    stream->last_progress = std::chrono::steady_clock::now();
+    
+    stream->job = state->history_store->submit(std::move(query),
+        [this, stream](const HistoryStore::Chunk& chunk) {
+            return queue_history_chunk(stream, chunk);
+        },
+        [this, stream](const std::string& error) {
+            post_history_error(stream, "History query failed: " + error);
+        }
+    );
+    
+    if (!stream->job) {
+        if (streams.empty()) {
+            history_streams.erase(hdl);
+        }
+        send_response(hdl, json{
+            {"status", "error"},
+            {"message", "History service busy"},
+            {"error_code", "HISTORY_BUSY"}
+        }, websocketpp::frame::opcode::text);
+        return;
+    }
+    streams.push_back(stream);
+}
+
+HistoryStore::Flow WebSocketServer::queue_history_chunk(const std::shared_ptr<HistoryStream>& stream,
+                                                        const HistoryStore::Chunk& chunk) {
+    // Runs on a history worker
+    std::string frame;
+    frame.reserve(chunk.rows.size() + stream->request_id.size() + 128);
+    frame += "{\"history\":{\"request_id\":";
+    frame += stream->request_id;
+    frame += ",\"sequence\":" + std::to_string(stream->sequence++);
+    frame += ",\"row_count\":" + std::to_string(chunk.row_count);
+    frame += std::string(",\"last\":") + (chunk.last ? "true" : "false");
+    frame += std::string(",\"truncated\":") + (chunk.truncated ? "true" : "false");
+    frame += ",\"rows\":";
+    frame += chunk.rows;
+    frame += "}}";
+    
+    // Posting under the stream mutex means a cancelled stream, and so a
+    // destroyed server, is never posted to
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    if (stream->cancelled) {
+        return HistoryStore::Flow::STOP;
+    }
+    
+    stream->in_flight++;
+    websocketpp::lib::asio::post(server.get_io_service(),
+        [this, stream, history_frame = HistoryFrame{std::move(frame), chunk.last}]() mutable {
+            queue_history_frame(stream, std::move(history_frame));
+        }
+    );
+    
+    // Holding at most a couple of chunks in flight bounds memory per query;
+    // past that the query is parked until the client catches up
+    if (stream->in_flight >= MAX_HISTORY_IN_FLIGHT) {
+        stream->parked = true;
+        return HistoryStore::Flow::PAUSE;
+    }
+    return HistoryStore::Flow::CONTINUE;
+}
+
+void WebSocketServer::post_history_error(const std::shared_ptr<HistoryStream>& stream, const std::string& message) {
+    // Runs on a history worker; queued behind the chunks already posted
+    std::string frame = history_error_frame(*stream, message);
+    
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    if (stream->cancelled) {
+        return;
+    }
+    
+    stream->in_flight++;
+    websocketpp::lib::asio::post(server.get_io_service(),
+        [this, stream, history_frame = HistoryFrame{std::move(frame), true}]() mutable {
+            queue_history_frame(stream, std::move(history_frame));
+        }
+    );
+}
+
+void WebSocketServer::queue_history_frame(const std::shared_ptr<HistoryStream>& stream, HistoryFrame frame) {
+    if (stream->cancelled) {
+        return;
+    }
+    stream->frames.push_back(std::move(frame));
+    pump_history_stream(stream);
+}
+
+void WebSocketServer::pump_history_stream(const std::shared_ptr<HistoryStream>& stream) {
+    if (stream->cancelled) {
+        return;
+    }
+    
+    websocketpp::lib::error_code ec;
+    auto con = server.get_con_from_hdl(stream->hdl, ec);
+    if (ec) {
+        return;     // on_close cancels the stream
+    }
+    
+    auto now = std::chrono::steady_clock::now();
+    while (!stream->frames.empty() && con->get_buffered_amount() < outbound_limits.coalesce_threshold_bytes) {
+        HistoryFrame frame = std::move(stream->frames.front());
+        stream->frames.pop_front();
+        
+        // History frames skip the outbound queue: they are never dropped or
+        // batched, and are paced by the in-flight limit instead
+        con->send(frame.payload, websocketpp::frame::opcode::text);
+        stream->last_progress = now;
+        
+        bool resume = false;
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            stream->in_flight--;
+            if (stream->parked && stream->in_flight < MAX_HISTORY_IN_FLIGHT) {
+                stream->parked = false;
+                resume = true;
+            }
+        }
+        if (resume) {
+            state->history_store->resume(stream->job);
+        }
+        
+        if (frame.last) {
+            finish_history_stream(stream);
+            return;
+        }
+    }
+    
+    if (stream->frames.empty() || stream->drain_scheduled) {
+        return;
+    }
+    
+    if (now - stream->last_progress >= HISTORY_STALL_TIMEOUT) {
+        abort_history_stream(stream, "History request cancelled: client stopped reading");
+        return;
+    }
+    
+    // Client is behind; retry once its socket drains
+    stream->drain_scheduled = true;
+    server.set_timer(outbound_limits.flush_interval_ms, [this, stream](const websocketpp::lib::error_code& timer_ec) {
+        stream->drain_scheduled = false;
+        if (!timer_ec) {
+            pump_history_stream(stream);
+        }
+    });
+}
+
+void WebSocketServer::abort_history_stream(const std::shared_ptr<HistoryStream>& stream, const std::string& message) {
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->cancelled = true;
+    }
+    
+    websocketpp::lib::error_code ec;
+    auto con = server.get_con_from_hdl(stream->hdl, ec);
+    if (!ec) {
+        con->send(history_error_frame(*stream, message), websocketpp::frame::opcode::text);
+    }
+    finish_history_stream(stream);
+}
+
+std::string WebSocketServer::history_error_frame(const HistoryStream& stream, const std::string& message) {
+    return json{
+        {"status", "error"},
+        {"message", message},
+        {"error_code", "HISTORY_ERROR"},
+        {"request_id", json::parse(stream.request_id)}
+    }.dump();
+}
+
+void WebSocketServer::finish_history_stream(const std::shared_ptr<HistoryStream>& stream) {
+    // The job's sinks hold the stream; drop the job to break the cycle
+    stream->job.reset();
+    stream->frames.clear();
+    
+    auto it = history_streams.find(stream->hdl);
+    if (it == history_streams.end()) {
+        return;
+    }
+    
+    auto& streams = it->second;
+    streams.erase(std::remove(streams.begin(), streams.end(), stream), streams.end());
+    if (streams.empty()) {
+        history_streams.erase(it);
+    }
+}
+
+void WebSocketServer::cancel_history_streams(connection_hdl hdl) {
+    auto it = history_streams.find(hdl);
+    if (it == history_streams.end()) {
+        return;
+    }
+    
+    // Workers check the flag before posting, so after this they abandon the
+    // query and never touch this server again
+    for (const auto& stream : it->second) {
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            stream->cancelled = true;
+        }
+        stream->job.reset();
+        stream->frames.clear();
+    }
+    history_streams.erase(it);
+}
+
+bool WebSocketServer::is_admin(const std::string& key_id) {
+    return authorization.can_access_sensor(key_id, "", Authorization::Permission::ADMIN);
 }
 
 void WebSocketServer::handle_admin_request(connection_hdl hdl, const json& data) {
@@ -213,25 +733,31 @@ void WebSocketServer::handle_admin_request(connection_hdl hdl, const json& data)
             handle_permission_management(hdl, data);
         } else if (action == "configure_rate_limit") {
             handle_rate_limit_config(hdl, data);
+        } else if (action == "manage_rules") {
+            handle_rule_management(hdl, data);
+        } else if (action == "subscribe_alerts") {
+            handle_alert_subscription(hdl, data);
+        } else if (action == "manage_api_keys") {
+            handle_api_key_management(hdl, data);
         } else {
-            server.send(hdl, json{
+            send_response(hdl, json{
                 {"status", "error"},
                 {"message", "Unknown admin action"},
                 {"error_code", "UNKNOWN_ADMIN_ACTION"}
-            }.dump(), websocketpp::frame::opcode::text);
+            }, websocketpp::frame::opcode::text);
         }
     } catch (const json::exception& e) {
-        server.send(hdl, json{
+        send_response(hdl, json{
             {"status", "error"},
             {"message", "Invalid admin request format"},
             {"error_code", "INVALID_ADMIN_REQUEST"}
-        }.dump(), websocketpp::frame::opcode::text);
+        }, websocketpp::frame::opcode::text);
     } catch (const std::exception& e) {
-        server.send(hdl, json{
+        send_response(hdl, json{
             {"status", "error"},
             {"message", std::string("Admin request error: ") + e.what()},
             {"error_code", "ADMIN_REQUEST_ERROR"}
-        }.dump(), websocketpp::frame::opcode::text);
+        }, websocketpp::frame::opcode::text);
     }
 }
 
@@ -249,10 +775,10 @@ void WebSocketServer::handle_system_stats(connection_hdl hdl, const json& data)
         stats["sensors"] = get_sensor_stats();
     }
     
-    server.send(hdl, json{
+    send_response(hdl, json{
         {"status", "success"},
         {"stats", stats}
-    }.dump(), websocketpp::frame::opcode::text);
+    }, websocketpp::frame::opcode::text);
 }
 
 void WebSocketServer::handle_user_management(connection_hdl hdl, const json& data) {
@@ -260,24 +786,28 @@ void WebSocketServer::handle_user_management(connection_hdl hdl, const json& dat
     std::string user_id = data["user_id"];
     
     if (operation == "add" || operation == "modify") {
-        Authorization::ClientPermissions perms;
-        for (const auto& perm : data["permissions"]) {
-            if (perm == "READ_SENSOR") perms.permissions.insert(Authorization::Permission::READ_SENSOR);
-            else if (perm == "WRITE_SENSOR") perms.permissions.insert(Authorization::Permission::WRITE_SENSOR);
-            else if (perm == "MANAGE_SENSORS") perms.permissions.insert(Authorization::Permission::MANAGE_SENSORS);
-            else if (perm == "ADMIN") perms.permissions.insert(Authorization::Permission::ADMIN);
-        }
-        perms.allowed_sensor_ids = data["allowed_sensors"].get<std::vector<std::string>>();
-        
-        authorization.add_client_permissions(user_id, perms);
-        server.send(hdl, json{
+        // user_id is the user's API key; permissions are stored under its key id
+        authorization.add_client_permissions(AuthHandler::key_id(user_id), parse_client_permissions(data));
+        send_response(hdl, json{
             {"status", "success"},
             {"message", "User permissions updated"}
-        }.dump(), websocketpp::frame::opcode::text);
+        }, websocketpp::frame::opcode::text);
     }
     // Additional operations can be added here
 }
 
+Authorization::ClientPermissions WebSocketServer::parse_client_permissions(const json& data) {
+    Authorization::ClientPermissions perms;
+    for (const auto& perm : data["permissions"]) {
+        if (perm == "READ_SENSOR") perms.permissions.insert(Authorization::Permission::READ_SENSOR);
+        else if (perm == "WRITE_SENSOR") perms.permissions.insert(Authorization::Permission::WRITE_SENSOR);
+        else if (perm == "MANAGE_SENSORS") perms.permissions.insert(Authorization::Permission::MANAGE_SENSORS);
+        else if (perm == "ADMIN") perms.permissions.insert(Authorization::Permission::ADMIN);
+    }
+    perms.allowed_sensor_ids = data["allowed_sensors"].get<std::vector<std::string>>();
+    return perms;
+}
+
 void WebSocketServer::handle_permission_management(connection_hdl hdl, const json& data) {
     std::string operation = data["operation"];
     std::string target_user = data["target_user"];
@@ -285,10 +815,10 @@ void WebSocketServer::handle_permission_management(connection_hdl hdl, const jso
     std::string sensor_id = data["sensor_id"];
     
     // Implementation depends on how you want to handle granular permissions
-    server.send(hdl, json{
+    send_response(hdl, json{
         {"status", "success"},
         {"message", "Permissions updated"}
-    }.dump(), websocketpp::frame::opcode::text);
+    }, websocketpp::frame::opcode::text);
 }
 
 void WebSocketServer::handle_rate_limit_config(connection_hdl hdl, const json& data) {
@@ -299,16 +829,157 @@ void WebSocketServer::handle_rate_limit_config(connection_hdl hdl, const json& d
     // Update rate limiter configuration
     // Note: This would require adding configuration methods to the RateLimiter class
     
-    server.send(hdl, json{
+    send_response(hdl, json{
         {"status", "success"},
         {"message", "Rate limit configuration updated"}
-    }.dump(), websocketpp::frame::opcode::text);
+    }, websocketpp::frame::opcode::text);
+}
+
+void WebSocketServer::handle_rule_management(connection_hdl hdl, const json& data) {
+    std::string operation = data["operation"];
+    
+    if (operation == "add") {
+        // Accept a single "rule" or a bulk "rules" array
+        std::vector<AlertRule> rules;
+        if (data.contains("rules")) {
+            rules = data["rules"].get<std::vector<AlertRule>>();
+        } else {
+            rules.push_back(data["rule"].get<AlertRule>());
+        }
+        
+        auto rule_ids = state->rule_engine.add_rules(std::move(rules));
+        send_response(hdl, json{
+            {"status", "success"},
+            {"message", "Rules added"},
+            {"rule_ids", rule_ids}
+        }, websocketpp::frame::opcode::text);
+    } else if (operation == "remove") {
+        uint32_t rule_id = data["rule_id"];
+        if (state->rule_engine.remove_rule(rule_id)) {
+            send_response(hdl, json{
+                {"status", "success"},
+                {"message", "Rule removed"}
+            }, websocketpp::frame::opcode::text);
+        } else {
+            send_response(hdl, json{
+                {"status", "error"},
+                {"message", "Unknown rule"},
+                {"error_code", "UNKNOWN_RULE"}
+            }, websocketpp::frame::opcode::text);
+        }
+    } else if (operation == "list") {
+        send_response(hdl, json{
+            {"status", "success"},
+            {"rules", state->rule_engine.list_rules()}
+        }, websocketpp::frame::opcode::text);
+    } else {
+        send_response(hdl, json{
+            {"status", "error"},
+            {"message", "Unknown rule operation"},
+            {"error_code", "UNKNOWN_RULE_OPERATION"}
+        }, websocketpp::frame::opcode::text);
+    }
+}
+
+void WebSocketServer::handle_api_key_management(connection_hdl hdl, const json& data) {
+    std::string operation = data["operation"];
+    bool updated = false;
+    
+    if (operation == "add") {
+        std::string api_key = data["api_key"];
+        updated = auth_handler.add_api_key(api_key);
+        if (updated && data.contains("permissions")) {
+            authorization.add_client_permissions(AuthHandler::key_id(api_key), parse_client_permissions(data));
+        }
+    } else if (operation == "remove") {
+        // Sessions and permissions of the key are dropped by the revocation listeners
+        updated = auth_handler.remove_api_key(data["api_key"]);
+    } else if (operation == "reload") {
+        auth_handler.reload_from_file();
+        updated = true;
+    } else {
+        send_response(hdl, json{
+            {"status", "error"},
+            {"message", "Unknown API key operation"},
+            {"error_code", "UNKNOWN_API_KEY_OPERATION"}
+        }, websocketpp::frame::opcode::text);
+        return;
+    }
+    
+    if (updated) {
+        send_response(hdl, json{
+            {"status", "success"},
+            {"message", "API keys updated"},
+            {"key_count", auth_handler.key_count()}
+        }, websocketpp::frame::opcode::text);
+    } else {
+        send_response(hdl, json{
+            {"status", "error"},
+            {"message", "API key not changed"},
+            {"error_code", "API_KEY_NOT_CHANGED"}
+        }, websocketpp::frame::opcode::text);
+    }
+}
+
+void WebSocketServer::handle_alert_subscription(connection_hdl hdl, const json& data) {
+    bool enabled = data.value("enabled", true);
+    
+    if (enabled) {
+        if (alert_subscribers.insert(hdl).second) {
+            alert_subscriber_count++;
+        }
+    } else if (alert_subscribers.erase(hdl) > 0) {
+        alert_subscriber_count--;
+    }
+    
+    send_response(hdl, json{
+        {"status", "success"},
+        {"message", enabled ? "Subscribed to alerts" : "Unsubscribed from alerts"}
+    }, websocketpp::frame::opcode::text);
+}
+
+void WebSocketServer::push_alerts(const std::string& payload) {
+    for (const auto& hdl : alert_subscribers) {
+        send_payload(hdl, payload, websocketpp::frame::opcode::text, true);
+    }
 }
 
 json WebSocketServer::get_connection_stats() {
     json stats = json::object();  // Create an empty JSON object
-    stats["active_connections"] = connections.size();
-    stats["total_connections"] = connections.size();  // Since WebSocket++ doesn't provide total count
+    stats["active_connections"] = state->active_connections.load();
+    stats["total_connections"] = state->total_connections.load();
+    stats["outbound"] = get_outbound_stats();
+    if (state->capture) {
+        stats["capture_dropped_records"] = state->capture->dropped_records();
+    }
+    return stats;
+}
+
+json WebSocketServer::get_outbound_stats() {
+    // Socket buffers are only visible to the shard that owns them
+    size_t buffered_bytes = 0;
+    size_t max_queue_depth = 0;
+    
+    for (const auto& entry : outbound) {
+        max_queue_depth = std::max(max_queue_depth, entry.second.queue.pending_messages());
+        
+        websocketpp::lib::error_code ec;
+        auto con = server.get_con_from_hdl(entry.first, ec);
+        if (!ec) {
+            buffered_bytes += con->get_buffered_amount();
+        }
+    }
+    
+    json stats = json::object();
+    stats["queued_messages"] = state->outbound_queued_messages.load();
+    stats["queued_bytes"] = state->outbound_queued_bytes.load();
+    stats["paused_connections"] = state->outbound_paused_connections.load();
+    stats["dropped_messages"] = state->outbound_dropped.load();
+    stats["overflow_disconnects"] = state->outbound_disconnects.load();
+    stats["this_shard"] = {
+        {"buffered_bytes", buffered_bytes},
+        {"max_queue_depth", max_queue_depth}
+    };
     return stats;
 }
 
@@ -323,5 +994,6 @@ json WebSocketServer::get_sensor_stats() {
     json stats = json::object();  // Create an empty JSON object
     stats["active_sensors"] = 0;  // Placeholder
     stats["total_readings"] = 0;  // Placeholder
+    stats["alert_rules"] = state->rule_engine.rule_count();
     return stats;
 } 
\ No newline at end of file
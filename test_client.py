@@ -11,10 +11,23 @@ import sys
 SERVER_URL = "ws://localhost:9002"
 API_KEY = "test-api-key-12345678901234567890123456789012"  # 32 chars minimum
 
+# Responses not yet handed out, per connection; the server may coalesce
+# several responses into one {"batch": [...]} frame when a client falls behind
+pending_responses = {}
+
+async def receive_message(websocket):
+    pending = pending_responses.setdefault(websocket, [])
+    while not pending:
+        frame = json.loads(await websocket.recv())
+        if isinstance(frame, dict) and isinstance(frame.get("batch"), list):
+            pending.extend(frame["batch"])
+        else:
+            pending.append(frame)
+    return pending.pop(0)
+
 async def send_message(websocket, message):
     await websocket.send(json.dumps(message))
-    response = await websocket.recv()
-    return json.loads(response)
+    return await receive_message(websocket)
 
 async def run_tests():
     try:
@@ -94,6 +107,26 @@ async def run_tests():
             invalid_unit_response = await send_message(websocket, invalid_unit_data)
             print(f"Invalid unit response: {invalid_unit_response}")
 
+            # Test 6: Stream historical readings
+            print("\n6. Testing History Query")
+            await websocket.send(json.dumps({
+                "history": {
+                    "request_id": "history-1",
+                    "sensor_id": "temp_sensor_001",
+                    "from": int(time.time()) - 3600,
+                    "limit": 1000
+                }
+            }))
+            while True:
+                frame = await receive_message(websocket)
+                if "history" not in frame:
+                    print(f"History error: {frame}")
+                    break
+                chunk = frame["history"]
+                print(f"History chunk {chunk['sequence']}: {chunk['row_count']} rows")
+                if chunk["last"]:
+                    break
+
     except websockets.exceptions.ConnectionRefusedError:
         print("Error: Could not connect to the server. Make sure it's running.")
     except Exception as e: